@@ -2,39 +2,576 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <regex>
+#include <map>
 #include <algorithm>
 #include <limits>
 #include <cassert>
 #include <ctime>
 #include <iomanip>
+#include <type_traits>
+#include <array>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <queue>
+#include <deque>
+#include <optional>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <bit>
+#include <charconv>
+#include <string_view>
+#include <csetjmp>
+#include <csignal>
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+#endif
+
+// Codec libraries for the streaming row decoder (--stream-rows); without them it decodes whole images
+#ifdef DYEGRADIENT_HAVE_TIFF
+#include <tiffio.h>
+#endif
+#ifdef DYEGRADIENT_HAVE_PNG
+#include <png.h>
+#endif
+#ifdef DYEGRADIENT_HAVE_JPEG
+#include <jpeglib.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DYEGRADIENT_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define DYEGRADIENT_TARGET(isa)
+#else
+#define DYEGRADIENT_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
 
 namespace fs = std::filesystem;
 
-// Function to extract unique RPMs from filenames
-std::vector<int> extractUniqueRPMs(const std::vector<std::string>& filenames, const std::string& identifier) {
-    std::set<int> uniqueRPMs;
-    std::regex pattern(identifier + "_(\\d+)_R\\d+");
-    std::smatch match;
+// Verbosity of std::cout output. Diagnostics above the current level are skipped entirely,
+// including any extra passes over the image needed to compute them.
+enum class LogLevel { Quiet, Info, Debug };
+static std::atomic<LogLevel> g_logLevel{LogLevel::Info};
+
+bool logEnabled(LogLevel level) {
+    return level <= g_logLevel.load(std::memory_order_relaxed);
+}
+
+// Function to escape a string for a JSON string literal
+std::string escapeJSON(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            std::snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// One completed span on the timeline
+struct TraceEvent {
+    const char* name;
+    double start;     // microseconds since tracing started
+    double duration;  // microseconds
+    int rpm;
+    int replicate;
+    std::string label;
+};
+
+// Timeline of scoped spans from all threads, written as Chrome trace JSON (chrome://tracing, Perfetto).
+// Each thread appends to its own buffer, registered once under the mutex, so recording takes no lock.
+// Write only after the traced threads have finished or gone idle.
+class TraceRecorder {
+public:
+    void start() {
+        origin = std::chrono::steady_clock::now();
+        enabled.store(true, std::memory_order_release);
+    }
+
+    bool isEnabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    double now() const {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    void record(TraceEvent event) {
+        thread_local ThreadEvents* local = nullptr;
+        if (!local) {
+            std::lock_guard<std::mutex> lock(mutex);
+            threads.push_back(std::make_unique<ThreadEvents>());
+            threads.back()->threadId = static_cast<int>(threads.size());
+            local = threads.back().get();
+        }
+        local->events.push_back(std::move(event));
+    }
+
+    bool write(const std::string& path) {
+        std::ofstream file(path);
+        if (!file.is_open()) {
+            std::cerr << "Error: Could not create trace file: " << path << std::endl;
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        file << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for (const auto& thread : threads) {
+            for (const auto& event : thread->events) {
+                file << (first ? "\n" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                     << thread->threadId << ",\"ts\":" << event.start << ",\"dur\":" << event.duration << ",\"args\":{";
+                const char* separator = "";
+                if (event.rpm >= 0) {
+                    file << "\"rpm\":" << event.rpm;
+                    separator = ",";
+                }
+                if (event.replicate >= 0) {
+                    file << separator << "\"replicate\":" << event.replicate;
+                    separator = ",";
+                }
+                if (!event.label.empty()) {
+                    file << separator << "\"label\":\"" << escapeJSON(event.label) << "\"";
+                }
+                file << "}}";
+                first = false;
+            }
+        }
+        file << "\n]}\n";
+        return file.good();
+    }
+
+private:
+    struct ThreadEvents {
+        int threadId = 0;
+        std::vector<TraceEvent> events;
+    };
+
+    std::atomic<bool> enabled{false};
+    std::chrono::steady_clock::time_point origin;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadEvents>> threads;
+};
+
+static TraceRecorder g_trace;
+
+// Records its own lifetime as a span on the trace timeline. With tracing off it costs one relaxed
+// load; rpm, replicate and label (which must outlive the scope) are only copied when tracing.
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : name(name), active(g_trace.isEnabled()) {
+        if (active) {
+            start = g_trace.now();
+        }
+    }
+
+    ~TraceScope() {
+        if (active) {
+            g_trace.record({name, start, g_trace.now() - start, rpm, replicate, label ? *label : std::string()});
+        }
+    }
+
+    int rpm = -1;
+    int replicate = -1;
+    const std::string* label = nullptr;
+
+private:
+    const char* name;
+    bool active;
+    double start = 0.0;
+};
+
+// cv::MatAllocator that recycles image buffers instead of returning them to the heap. Buffers are
+// grouped in size classes (four per power of two, so at most 25% is wasted) and a freed buffer goes
+// on its class's free list for the next image of a similar size. Any cv::Mat whose allocator is set
+// to the pool before it is created (imdecode destination, blur and conversion outputs) draws from
+// it, and OpenCV's reference counting returns the buffer once the last Mat sharing it is gone. After
+// the first RPM groups a run settles into reusing the same few buffers. Free buffers are kept up to
+// kMaxFreeBytes in total; beyond that, the size classes used least recently are released first, so
+// sizes a long run no longer needs (an earlier preview, a rewritten image) do not stay allocated.
+class MatPool : public cv::MatAllocator {
+public:
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data0, size_t* step,
+                           cv::AccessFlag /*flags*/, cv::UMatUsageFlags /*usageFlags*/) const override {
+        size_t total = CV_ELEM_SIZE(type);
+        for (int i = dims - 1; i >= 0; --i) {
+            if (step) {
+                if (data0 && step[i] != CV_AUTOSTEP) {
+                    total = step[i];
+                } else {
+                    step[i] = total;
+                }
+            }
+            total *= sizes[i];
+        }
+
+        cv::UMatData* u = new cv::UMatData(this);
+        u->size = total;
+        if (data0) {
+            u->data = u->origdata = static_cast<uchar*>(data0);
+            u->flags |= cv::UMatData::USER_ALLOCATED;
+            return u;
+        }
+
+        size_t capacity = sizeClass(total);
+        uchar* data = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = freeBuffers.find(capacity);
+            if (it != freeBuffers.end() && !it->second.buffers.empty()) {
+                data = it->second.buffers.back();
+                it->second.buffers.pop_back();
+                it->second.lastUse = ++useCounter;
+                freeBytes -= capacity;
+                ++reuseCount;
+            } else {
+                ++allocationCount;
+                allocatedBytes += capacity;
+            }
+        }
+        if (!data) {
+            data = static_cast<uchar*>(cv::fastMalloc(capacity));
+        }
+        u->data = u->origdata = data;
+        return u;
+    }
+
+    bool allocate(cv::UMatData* u, cv::AccessFlag /*accessFlags*/, cv::UMatUsageFlags /*usageFlags*/) const override {
+        return u != nullptr;
+    }
+
+    void deallocate(cv::UMatData* u) const override {
+        if (!u) {
+            return;
+        }
+        CV_Assert(u->urefcount == 0);
+        CV_Assert(u->refcount == 0);
+        std::vector<uchar*> released;
+        if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+            size_t capacity = sizeClass(u->size);
+            std::lock_guard<std::mutex> lock(mutex);
+            FreeList& freeList = freeBuffers[capacity];
+            freeList.buffers.push_back(u->origdata);
+            freeList.lastUse = ++useCounter;
+            freeBytes += capacity;
+            u->origdata = nullptr;
+            trim(released);
+        }
+        for (uchar* data : released) {
+            cv::fastFree(data);
+        }
+        delete u;
+    }
+
+    // Function to describe the pool's activity for the performance report
+    std::string summary() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(1) << "Image buffers: " << allocationCount << " allocated ("
+             << allocatedBytes / 1e6 << " MB), " << reuseCount << " reused from the pool, " << releaseCount
+             << " released (" << freeBytes / 1e6 << " MB free in the pool)";
+        return text.str();
+    }
+
+private:
+    static constexpr size_t kMaxFreeBytes = size_t(1) << 30;
+
+    // Free buffers of one size class, and when the class was last allocated from or returned to
+    struct FreeList {
+        std::vector<uchar*> buffers;
+        uint64_t lastUse = 0;
+    };
+
+    // Function to take buffers out of the least recently used size classes until the free buffers fit in
+    // kMaxFreeBytes; the caller frees them after releasing the lock
+    void trim(std::vector<uchar*>& released) const {
+        while (freeBytes > kMaxFreeBytes) {
+            auto oldest = freeBuffers.end();
+            for (auto it = freeBuffers.begin(); it != freeBuffers.end(); ++it) {
+                if (!it->second.buffers.empty() && (oldest == freeBuffers.end() || it->second.lastUse < oldest->second.lastUse)) {
+                    oldest = it;
+                }
+            }
+            released.push_back(oldest->second.buffers.back());
+            oldest->second.buffers.pop_back();
+            freeBytes -= oldest->first;
+            ++releaseCount;
+            if (oldest->second.buffers.empty()) {
+                freeBuffers.erase(oldest);
+            }
+        }
+    }
+
+    static size_t sizeClass(size_t bytes) {
+        if (bytes <= 4096) {
+            return 4096;
+        }
+        size_t step = std::bit_floor(bytes - 1) / 4;
+        return (bytes + step - 1) / step * step;
+    }
+
+    mutable std::mutex mutex;
+    mutable std::map<size_t, FreeList> freeBuffers;
+    mutable size_t freeBytes = 0;
+    mutable uint64_t useCounter = 0;
+    mutable size_t releaseCount = 0;
+    mutable size_t allocatedBytes = 0;
+    mutable size_t allocationCount = 0;
+    mutable size_t reuseCount = 0;
+};
+
+// Never destroyed, so Mats released during static destruction can still hand their buffers back
+static MatPool& g_matPool = *new MatPool;
+
+// Function to get an empty cv::Mat whose data, once created, comes from the buffer pool
+cv::Mat pooledMat() {
+    cv::Mat mat;
+    mat.allocator = &g_matPool;
+    return mat;
+}
+
+// Function to get the peak resident set size of the process in bytes, or 0 if unknown
+size_t getPeakRSS() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// Pipeline stages timed for the end-of-run performance report
+enum class Stage { Scan, Decode, Blur, Align, AlignedWrite, Reduce, CsvWrite, BinaryWrite, Count };
+
+const char* stageName(Stage stage) {
+    switch (stage) {
+        case Stage::Scan: return "Filename scan";
+        case Stage::Decode: return "Image decode";
+        case Stage::Blur: return "Blur";
+        case Stage::Align: return "Align";
+        case Stage::AlignedWrite: return "Aligned TIFF write";
+        case Stage::Reduce: return "Column reduction";
+        case Stage::CsvWrite: return "CSV write";
+        case Stage::BinaryWrite: return "Binary write";
+        default: return "?";
+    }
+}
+
+// One timed run of a stage and the amount of data it handled
+struct StageSample {
+    double seconds;
+    double bytes;
+    double pixels;
+};
+
+// Timings of every stage run, collected from all threads for the performance report
+class StageStatistics {
+public:
+    void record(Stage stage, const StageSample& sample) {
+        std::lock_guard<std::mutex> lock(mutex);
+        samples[static_cast<size_t>(stage)].push_back(sample);
+    }
+
+    std::vector<StageSample> get(Stage stage) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return samples[static_cast<size_t>(stage)];
+    }
+
+private:
+    std::mutex mutex;
+    std::array<std::vector<StageSample>, static_cast<size_t>(Stage::Count)> samples;
+};
+
+static StageStatistics g_stageStatistics;
+
+// Times its own lifetime as one sample of a stage, and as a span on the trace timeline. Set
+// bytes/pixels to the data handled so the report can show throughput.
+class StageTimer {
+public:
+    explicit StageTimer(Stage stage) : trace(stageName(stage)), stage(stage), start(std::chrono::steady_clock::now()) {}
+
+    ~StageTimer() {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        g_stageStatistics.record(stage, {elapsed.count(), bytes, pixels});
+    }
+
+    // Function to count an image's bytes and pixels as handled by this stage run
+    void addImage(const cv::Mat& image) {
+        bytes += static_cast<double>(image.total() * image.elemSize());
+        pixels += static_cast<double>(image.total());
+    }
+
+    TraceScope trace;
+    double bytes = 0.0;
+    double pixels = 0.0;
+
+private:
+    Stage stage;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Function to print per-stage totals, per-run percentiles and throughput. Stages run concurrently,
+// so their totals can add up to more than the wall time.
+void printPerformanceReport(double wallSeconds) {
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(3);
+    report << "Performance report (wall time " << wallSeconds << " s):\n"
+           << std::left << std::setw(20) << "Stage" << std::right << std::setw(7) << "Runs" << std::setw(11) << "Total s"
+           << std::setw(10) << "p50 ms" << std::setw(10) << "p90 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "Max ms"
+           << std::setw(10) << "MB/s" << std::setw(10) << "MP/s" << "\n";
+    for (size_t i = 0; i < static_cast<size_t>(Stage::Count); ++i) {
+        std::vector<StageSample> samples = g_stageStatistics.get(static_cast<Stage>(i));
+        if (samples.empty()) {
+            continue;
+        }
+        std::vector<double> durations;
+        double totalSeconds = 0.0, totalBytes = 0.0, totalPixels = 0.0;
+        for (const auto& sample : samples) {
+            durations.push_back(sample.seconds);
+            totalSeconds += sample.seconds;
+            totalBytes += sample.bytes;
+            totalPixels += sample.pixels;
+        }
+        std::sort(durations.begin(), durations.end());
+        // Nearest-rank percentile of the per-run durations, in milliseconds
+        auto percentile = [&](double p) {
+            size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * durations.size()));
+            return 1000.0 * durations[std::max<size_t>(rank, 1) - 1];
+        };
+        auto rate = [&](double amount) { return totalSeconds > 0.0 ? amount / 1e6 / totalSeconds : 0.0; };
+
+        report << std::left << std::setw(20) << stageName(static_cast<Stage>(i)) << std::right
+               << std::setw(7) << samples.size() << std::setw(11) << totalSeconds << std::setprecision(2)
+               << std::setw(10) << percentile(50) << std::setw(10) << percentile(90) << std::setw(10) << percentile(99)
+               << std::setw(10) << 1000.0 * durations.back() << std::setprecision(1);
+        report << std::setw(10);
+        if (totalBytes > 0.0) report << rate(totalBytes); else report << "-";
+        report << std::setw(10);
+        if (totalPixels > 0.0) report << rate(totalPixels); else report << "-";
+        report << std::setprecision(3) << "\n";
+    }
+    report << g_matPool.summary() << ", peak RSS " << std::setprecision(1) << getPeakRSS() / 1e6 << " MB\n";
+    std::cout << report.str() << std::flush;
+}
+
+// Files of one RPM group keyed by replicate number (a multimap, so duplicate replicates stay visible)
+using ReplicateFiles = std::multimap<int, std::string>;
+
+// Index of an input folder: identifier -> RPM -> replicate -> filename
+using FilenameIndex = std::map<std::string, std::map<int, ReplicateFiles>>;
+
+// Function to parse an unsigned decimal number at filename[pos], advancing pos past it
+bool parseFilenameNumber(const std::string& filename, size_t& pos, int& value) {
+    size_t begin = pos;
+    value = 0;
+    while (pos < filename.size() && filename[pos] >= '0' && filename[pos] <= '9' && pos - begin < 9) {
+        value = value * 10 + (filename[pos] - '0');
+        ++pos;
+    }
+    return pos > begin;
+}
+
+// Function to parse a filename of the form <identifier>_<rpm>_R<replicate><anything>.
+// The identifier is everything before the first "_<digits>_R<digits>" token.
+bool parseReplicateFilename(const std::string& filename, std::string& identifier, int& rpm, int& replicate) {
+    for (size_t underscore = filename.find('_'); underscore != std::string::npos;
+         underscore = filename.find('_', underscore + 1)) {
+        size_t pos = underscore + 1;
+        if (underscore == 0 || !parseFilenameNumber(filename, pos, rpm)) {
+            continue;
+        }
+        if (filename.compare(pos, 2, "_R") != 0) {
+            continue;
+        }
+        pos += 2;
+        if (!parseFilenameNumber(filename, pos, replicate)) {
+            continue;
+        }
+        identifier = filename.substr(0, underscore);
+        return true;
+    }
+    return false;
+}
 
+// Function to index filenames by identifier, RPM and replicate in a single pass
+FilenameIndex buildFilenameIndex(const std::vector<std::string>& filenames) {
+    FilenameIndex index;
+    std::string identifier;
+    int rpm, replicate;
     for (const auto& filename : filenames) {
-        if (std::regex_search(filename, match, pattern)) {
-            uniqueRPMs.insert(std::stoi(match[1].str()));
+        if (parseReplicateFilename(filename, identifier, rpm, replicate)) {
+            index[identifier][rpm].emplace(replicate, filename);
+        }
+    }
+    return index;
+}
+
+// Function to get the RPM groups of one identifier, or nullptr if it has none
+const std::map<int, ReplicateFiles>* findRPMGroups(const FilenameIndex& index, const std::string& identifier) {
+    auto it = index.find(identifier);
+    return (it != index.end()) ? &it->second : nullptr;
+}
+
+// Function to extract unique RPMs from the filename index
+std::vector<int> extractUniqueRPMs(const FilenameIndex& index, const std::string& identifier) {
+    std::vector<int> uniqueRPMs;
+    if (const auto* groups = findRPMGroups(index, identifier)) {
+        for (const auto& group : *groups) {
+            uniqueRPMs.push_back(group.first);
         }
     }
-    return std::vector<int>(uniqueRPMs.begin(), uniqueRPMs.end());
+    return uniqueRPMs;
 }
 
 // Function to validate that each RPM has three replicates
-bool validateReplicates(const std::vector<std::string>& filenames, const std::vector<int>& uniqueRPMs, const std::string& identifier) {
+bool validateReplicates(const FilenameIndex& index, const std::vector<int>& uniqueRPMs, const std::string& identifier) {
+    const auto* groups = findRPMGroups(index, identifier);
     for (const auto& rpm : uniqueRPMs) {
-        int count = 0;
-        for (const auto& filename : filenames) {
-            if (filename.find(identifier + "_" + std::to_string(rpm) + "_R") != std::string::npos) {
-                ++count;
-            }
-        }
-        if (count != 3) {
+        if (!groups || !groups->count(rpm) || groups->at(rpm).size() != 3) {
             std::cerr << "Error: RPM " << rpm << " does not have exactly 3 replicates.\n";
             return false;
         }
@@ -85,165 +622,2760 @@ void alignImageHeights(std::vector<cv::Mat>& images) {
     }
 }
 
-// Function to process images for a specific RPM
-void processRPMImages(const std::vector<std::string>& filenames, const std::string& folderPath, 
-                     int rpm, const std::string& outputFolder, const std::string& identifier,
-                     double distanceUpper, double distanceLower, char channelChoice, int blurRadius) {
-    std::vector<cv::Mat> images;
-    std::vector<std::string> replicateNames;
+// Instruction sets the column reduction kernel can be dispatched to at runtime
+enum class SimdLevel { Scalar, SSE42, AVX2, AVX512 };
 
-    std::cout << "Processing RPM: " << rpm << std::endl;
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::SSE42: return "SSE4.2";
+        case SimdLevel::AVX2: return "AVX2";
+        case SimdLevel::AVX512: return "AVX-512";
+        default: return "scalar";
+    }
+}
 
-    // Load images and apply Gaussian Blur if requested
-    for (const auto& filename : filenames) {
-        if (filename.find(identifier + "_" + std::to_string(rpm) + "_R") != std::string::npos) {
-            std::cout << "Loading image: " << filename << std::endl;
-            cv::Mat image = cv::imread(folderPath + "/" + filename, cv::IMREAD_UNCHANGED);
-            if (image.empty()) {
-                std::cerr << "Error: Could not load image: " << filename << std::endl;
-                continue;
+// Function to detect the widest instruction set supported by the CPU and the OS
+SimdLevel detectSimdLevel() {
+#if defined(DYEGRADIENT_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse42 = (info[2] & (1 << 20)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool ymmEnabled = (xcr0 & 0x6) == 0x6;
+    bool zmmEnabled = (xcr0 & 0xE6) == 0xE6;
+    bool avx2 = false, avx512 = false;
+    if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+        avx512 = (info[1] & (1 << 16)) != 0;
+    }
+    if (avx512 && zmmEnabled) return SimdLevel::AVX512;
+    if (avx2 && avx && ymmEnabled) return SimdLevel::AVX2;
+    if (sse42) return SimdLevel::SSE42;
+#elif defined(DYEGRADIENT_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse4.2")) return SimdLevel::SSE42;
+#endif
+    return SimdLevel::Scalar;
+}
+
+// Bit masks selecting which chromaticities a reduction produces; bit c is channel c (0 = B, 1 = G, 2 = R)
+constexpr int kBlueMask = 1 << 0;
+constexpr int kGreenMask = 1 << 1;
+constexpr int kRedMask = 1 << 2;
+constexpr int kAllChannelsMask = kBlueMask | kGreenMask | kRedMask;
+
+// Per-column sum arrays for the blue, green and red chromaticity; channels outside the mask stay null
+struct ChannelSums {
+    double* channel[3] = {nullptr, nullptr, nullptr};
+
+    ChannelSums offset(int x) const {
+        ChannelSums shifted;
+        for (int c = 0; c < 3; ++c) {
+            shifted.channel[c] = channel[c] ? channel[c] + x : nullptr;
+        }
+        return shifted;
+    }
+};
+
+// Column reduction kernels: add the chromaticity (selected / (r + g + b)) of every pixel in one
+// interleaved BGR float row to the matching entry of the column sums of each channel in Mask. The
+// mask is a template parameter, so each instantiation has a branch-free inner loop, and all
+// requested channels come out of a single read of the row.
+// All variants divide in single precision and accumulate in double in the same order as the scalar
+// loop, so their sums are bit-identical to it (tolerance: 0 ULP); pixels with luminance <= 0 add 0.
+using ChromaticityRowKernel = void (*)(const float* bgr, int cols, ChannelSums sums);
+
+template <int Mask>
+void accumulateChromaticityRowScalar(const float* bgr, int cols, ChannelSums sums) {
+    for (int x = 0; x < cols; ++x) {
+        const float* pixel = bgr + 3 * x;
+        float luminance = pixel[2] + pixel[1] + pixel[0];
+        for (int c = 0; c < 3; ++c) {
+            if ((Mask >> c) & 1) {
+                sums.channel[c][x] += (luminance > 0) ? pixel[c] / luminance : 0.0f;
             }
-            std::cout << "Original image dimensions: " << image.rows << "x" << image.cols << std::endl;
+        }
+    }
+}
+
+#ifdef DYEGRADIENT_X86
+template <int Mask>
+DYEGRADIENT_TARGET("sse4.2")
+void accumulateChromaticityRowSSE42(const float* bgr, int cols, ChannelSums sums) {
+    const __m128 zero = _mm_setzero_ps();
+    int x = 0;
+    for (; x + 4 <= cols; x += 4) {
+        const float* p = bgr + 3 * x;
+        __m128 m0 = _mm_loadu_ps(p);
+        __m128 m1 = _mm_loadu_ps(p + 4);
+        __m128 m2 = _mm_loadu_ps(p + 8);
 
-            // Apply Gaussian Blur only if radius > 0
-            if (blurRadius > 0) {
-                cv::GaussianBlur(image, image, cv::Size(2 * blurRadius + 1, 2 * blurRadius + 1), 0);
+        // Deinterleave 4 BGR pixels into one register per channel
+        __m128 gr = _mm_shuffle_ps(m1, m2, _MM_SHUFFLE(2, 1, 3, 2));
+        __m128 bg = _mm_shuffle_ps(m0, m1, _MM_SHUFFLE(1, 0, 2, 1));
+        __m128 channels[3] = {
+            _mm_shuffle_ps(m0, gr, _MM_SHUFFLE(2, 0, 3, 0)),
+            _mm_shuffle_ps(bg, gr, _MM_SHUFFLE(3, 1, 2, 0)),
+            _mm_shuffle_ps(bg, m2, _MM_SHUFFLE(3, 0, 3, 1))
+        };
+
+        __m128 luminance = _mm_add_ps(_mm_add_ps(channels[2], channels[1]), channels[0]);
+        __m128 positive = _mm_cmpgt_ps(luminance, zero);
+        for (int c = 0; c < 3; ++c) {
+            if ((Mask >> c) & 1) {
+                __m128 ratio = _mm_and_ps(_mm_div_ps(channels[c], luminance), positive);
+                double* columnSums = sums.channel[c] + x;
+                _mm_storeu_pd(columnSums, _mm_add_pd(_mm_loadu_pd(columnSums), _mm_cvtps_pd(ratio)));
+                _mm_storeu_pd(columnSums + 2, _mm_add_pd(_mm_loadu_pd(columnSums + 2),
+                                                         _mm_cvtps_pd(_mm_movehl_ps(ratio, ratio))));
             }
-            images.push_back(image);
-            replicateNames.push_back(filename);
         }
     }
+    accumulateChromaticityRowScalar<Mask>(bgr + 3 * x, cols - x, sums.offset(x));
+}
 
-    // Check if we have the expected number of replicates
-    if (images.size() != 3) {
-        std::cerr << "Error: Unexpected number of images for RPM " << rpm << ". Expected 3, but found " << images.size() << "." << std::endl;
-        return;
+template <int Mask>
+DYEGRADIENT_TARGET("avx2")
+void accumulateChromaticityRowAVX2(const float* bgr, int cols, ChannelSums sums) {
+    const __m256 zero = _mm256_setzero_ps();
+    int x = 0;
+    for (; x + 8 <= cols; x += 8) {
+        const float* p = bgr + 3 * x;
+        // Pixels 0-3 go to the low lanes and pixels 4-7 to the high lanes
+        __m256 m03 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)), _mm_loadu_ps(p + 12), 1);
+        __m256 m14 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 4)), _mm_loadu_ps(p + 16), 1);
+        __m256 m25 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 8)), _mm_loadu_ps(p + 20), 1);
+
+        __m256 gr = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+        __m256 bg = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+        __m256 channels[3] = {
+            _mm256_shuffle_ps(m03, gr, _MM_SHUFFLE(2, 0, 3, 0)),
+            _mm256_shuffle_ps(bg, gr, _MM_SHUFFLE(3, 1, 2, 0)),
+            _mm256_shuffle_ps(bg, m25, _MM_SHUFFLE(3, 0, 3, 1))
+        };
+
+        __m256 luminance = _mm256_add_ps(_mm256_add_ps(channels[2], channels[1]), channels[0]);
+        __m256 positive = _mm256_cmp_ps(luminance, zero, _CMP_GT_OQ);
+        for (int c = 0; c < 3; ++c) {
+            if ((Mask >> c) & 1) {
+                __m256 ratio = _mm256_and_ps(_mm256_div_ps(channels[c], luminance), positive);
+                double* columnSums = sums.channel[c] + x;
+                _mm256_storeu_pd(columnSums, _mm256_add_pd(_mm256_loadu_pd(columnSums),
+                                                           _mm256_cvtps_pd(_mm256_castps256_ps128(ratio))));
+                _mm256_storeu_pd(columnSums + 4, _mm256_add_pd(_mm256_loadu_pd(columnSums + 4),
+                                                               _mm256_cvtps_pd(_mm256_extractf128_ps(ratio, 1))));
+            }
+        }
     }
+    accumulateChromaticityRowScalar<Mask>(bgr + 3 * x, cols - x, sums.offset(x));
+}
 
-    // Align image widths and heights
-    alignImageWidths(images);
-    alignImageHeights(images);
-    // Save aligned and blurred images for verification
-    std::string alignedImagesPath = outputFolder + "/aligned_images";
-    std::filesystem::create_directories(alignedImagesPath);
-    
-    for (size_t i = 0; i < images.size(); ++i) {
-        cv::Mat saveImage;
-        
-        // Debug original image info
-        std::cout << "Original image type: " << images[i].type() 
-                  << ", channels: " << images[i].channels() 
-                  << ", min/max values: ";
-        double minVal, maxVal;
-        cv::minMaxLoc(images[i], &minVal, &maxVal);
-        std::cout << minVal << "/" << maxVal << std::endl;
+template <int Mask>
+DYEGRADIENT_TARGET("avx512f")
+void accumulateChromaticityRowAVX512(const float* bgr, int cols, ChannelSums sums) {
+    // Permutation indices gathering channel c of 16 pixels from three consecutive 16-float loads:
+    // the first permute picks from loads 0/1, the second patches in the elements held by load 2
+    __m512i firstIndex[3], secondIndex[3];
+    for (int c = 0; c < 3; ++c) {
+        alignas(64) int first[16], second[16];
+        for (int i = 0; i < 16; ++i) {
+            int source = 3 * i + c;
+            first[i] = source < 32 ? source : 0;
+            second[i] = source < 32 ? i : 16 + (source - 32);
+        }
+        firstIndex[c] = _mm512_load_si512(first);
+        secondIndex[c] = _mm512_load_si512(second);
+    }
 
-        // Preserve floating point data by saving directly
-        images[i].convertTo(saveImage, CV_32F);  // Keep as float
+    const __m512 zero = _mm512_setzero_ps();
+    int x = 0;
+    for (; x + 16 <= cols; x += 16) {
+        const float* p = bgr + 3 * x;
+        __m512 m0 = _mm512_loadu_ps(p);
+        __m512 m1 = _mm512_loadu_ps(p + 16);
+        __m512 m2 = _mm512_loadu_ps(p + 32);
 
-        // Ensure proper path separators and file extension
-        std::string outputFilename = alignedImagesPath + "/" + 
-            identifier + "_" + std::to_string(rpm) + "_R" + std::to_string(i + 1) + 
-            "_" + std::to_string(images[i].cols) + "x" + std::to_string(images[i].rows) + 
-            "_aligned.tif";  // Changed to .tif
-            
-        // Replace any potential Windows backslashes with forward slashes
-        std::replace(outputFilename.begin(), outputFilename.end(), '\\', '/');
-        
-        std::cout << "Saving aligned image to: " << outputFilename << std::endl;
-        std::cout << "Image type before saving: " << saveImage.type() 
-                  << ", channels: " << saveImage.channels() << std::endl;
-        
-        // Use TIFF-specific parameters to preserve float data
-        std::vector<int> compression_params;
-        compression_params.push_back(cv::IMWRITE_TIFF_COMPRESSION);
-        compression_params.push_back(1);  // No compression
-        
-        bool success = cv::imwrite(outputFilename, saveImage, compression_params);
-        if (!success) {
-            std::cerr << "Failed to save image: " << outputFilename << std::endl;
+        __m512 channels[3];
+        for (int c = 0; c < 3; ++c) {
+            channels[c] = _mm512_permutex2var_ps(_mm512_permutex2var_ps(m0, firstIndex[c], m1), secondIndex[c], m2);
+        }
+
+        __m512 luminance = _mm512_add_ps(_mm512_add_ps(channels[2], channels[1]), channels[0]);
+        __mmask16 positive = _mm512_cmp_ps_mask(luminance, zero, _CMP_GT_OQ);
+        for (int c = 0; c < 3; ++c) {
+            if ((Mask >> c) & 1) {
+                __m512 ratio = _mm512_maskz_div_ps(positive, channels[c], luminance);
+                __m256 high = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(ratio), 1));
+                double* columnSums = sums.channel[c] + x;
+                _mm512_storeu_pd(columnSums, _mm512_add_pd(_mm512_loadu_pd(columnSums),
+                                                           _mm512_cvtps_pd(_mm512_castps512_ps256(ratio))));
+                _mm512_storeu_pd(columnSums + 8, _mm512_add_pd(_mm512_loadu_pd(columnSums + 8),
+                                                               _mm512_cvtps_pd(high)));
+            }
         }
     }
+    accumulateChromaticityRowScalar<Mask>(bgr + 3 * x, cols - x, sums.offset(x));
+}
+#endif
 
-    // Debug aligned image dimensions
-    for (size_t i = 0; i < images.size(); ++i) {
-        std::cout << "Aligned image " << (i + 1) << " dimensions: "
-                  << images[i].rows << "x" << images[i].cols << std::endl;
+// Function to pick the column reduction kernel for a channel mask and the widest supported instruction set
+template <int Mask>
+ChromaticityRowKernel selectChromaticityRowKernel(SimdLevel level) {
+#ifdef DYEGRADIENT_X86
+    switch (level) {
+        case SimdLevel::AVX512: return accumulateChromaticityRowAVX512<Mask>;
+        case SimdLevel::AVX2: return accumulateChromaticityRowAVX2<Mask>;
+        case SimdLevel::SSE42: return accumulateChromaticityRowSSE42<Mask>;
+        default: break;
     }
+#else
+    (void)level;
+#endif
+    return accumulateChromaticityRowScalar<Mask>;
+}
 
-    // Prepare CSV output
-    std::string csvFilePath = outputFolder + "/" + identifier + "_" + std::to_string(rpm) + "_" + std::string(1, channelChoice) + "ness.csv";
-    std::ofstream csvFile(csvFilePath);
-    if (!csvFile.is_open()) {
-        std::cerr << "Error: Could not create CSV file: " << csvFilePath << std::endl;
-        return;
+ChromaticityRowKernel selectChromaticityRowKernel(SimdLevel level, int channelMask) {
+    switch (channelMask) {
+        case kBlueMask: return selectChromaticityRowKernel<kBlueMask>(level);
+        case kGreenMask: return selectChromaticityRowKernel<kGreenMask>(level);
+        case kRedMask: return selectChromaticityRowKernel<kRedMask>(level);
+        default: return selectChromaticityRowKernel<kAllChannelsMask>(level);
     }
+}
 
-    std::cout << "Writing CSV to: " << csvFilePath << std::endl;
+// Pixels widened per chunk when reducing 8- or 16-bit rows; the float chunk stays in L1
+constexpr int kWidenChunkPixels = 256;
 
-    // Update CSV headers based on channel
-    std::string channelName;
+// Function to run a row kernel over rows [rowBegin, rowEnd) of an image of element type T.
+// Float rows are passed to the kernel directly; integer rows are converted chunk by chunk.
+template <typename T>
+void accumulateChromaticityRows(const cv::Mat& image, int rowBegin, int rowEnd,
+                                ChromaticityRowKernel accumulateRow, ChannelSums sums) {
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        const T* row = image.ptr<T>(y);
+        if constexpr (std::is_same_v<T, float>) {
+            accumulateRow(row, image.cols, sums);
+        } else {
+            float chunk[3 * kWidenChunkPixels];
+            for (int x = 0; x < image.cols; x += kWidenChunkPixels) {
+                int count = std::min(kWidenChunkPixels, image.cols - x);
+                const T* source = row + 3 * x;
+                for (int i = 0; i < 3 * count; ++i) {
+                    chunk[i] = static_cast<float>(source[i]);
+                }
+                accumulateRow(chunk, count, sums.offset(x));
+            }
+        }
+    }
+}
+
+// Function to run a row kernel over rows [rowBegin, rowEnd) of a float image stored in RGB order (a mapped
+// TIFF). Each chunk is copied into BGR order in L1, so the kernel adds the channels in the same order as
+// for a decoded image and the float sums come out bit-identical.
+void accumulateChromaticityRowsFromRGB(const cv::Mat& image, int rowBegin, int rowEnd,
+                                       ChromaticityRowKernel accumulateRow, ChannelSums sums) {
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        const float* row = image.ptr<float>(y);
+        float chunk[3 * kWidenChunkPixels];
+        for (int x = 0; x < image.cols; x += kWidenChunkPixels) {
+            int count = std::min(kWidenChunkPixels, image.cols - x);
+            const float* source = row + 3 * x;
+            for (int i = 0; i < count; ++i) {
+                chunk[3 * i] = source[3 * i + 2];
+                chunk[3 * i + 1] = source[3 * i + 1];
+                chunk[3 * i + 2] = source[3 * i];
+            }
+            accumulateRow(chunk, count, sums.offset(x));
+        }
+    }
+}
+
+using ChromaticityRowsReducer = void (*)(const cv::Mat& image, int rowBegin, int rowEnd,
+                                         ChromaticityRowKernel accumulateRow, ChannelSums sums);
+
+// Function to pick the row reducer for an image depth, or nullptr for unsupported depths
+ChromaticityRowsReducer selectChromaticityRowsReducer(int depth) {
+    switch (depth) {
+        case CV_8U: return accumulateChromaticityRows<uchar>;
+        case CV_16U: return accumulateChromaticityRows<ushort>;
+        case CV_32F: return accumulateChromaticityRows<float>;
+    }
+    return nullptr;
+}
+
+// Function to get the index (0 = B, 1 = G, 2 = R) of a channel choice
+int getChannelIndex(char channelChoice) {
+    return (channelChoice == 'R') ? 2 : (channelChoice == 'G') ? 1 : 0;
+}
+
+// Function to get the mask of channels reduced for a channel choice ('A' selects all three)
+int getChannelMask(char channelChoice) {
+    return (channelChoice == 'A') ? kAllChannelsMask : (1 << getChannelIndex(channelChoice));
+}
+
+// Function to swap the red and blue bits of a channel mask, for reducing images stored in RGB order
+int swapRedBlueBits(int channelMask) {
+    return (channelMask & kGreenMask) | ((channelMask & kRedMask) ? kBlueMask : 0) |
+           ((channelMask & kBlueMask) ? kRedMask : 0);
+}
+
+// Function to get the CSV column name for a channel choice
+std::string getChannelName(char channelChoice) {
     switch (channelChoice) {
-        case 'R': channelName = "Redness"; break;
-        case 'G': channelName = "Greenness"; break;
-        case 'B': channelName = "Blueness"; break;
+        case 'R': return "Redness";
+        case 'G': return "Greenness";
+        case 'B': return "Blueness";
     }
-    
-    csvFile << "Distance (cm)," << channelName << " R1," << channelName << " R2," 
-            << channelName << " R3,Average " << channelName << "\n";
+    return "";
+}
 
-    int cols = images[0].cols;
-    int rows = images[0].rows;
-    double pixelWidth = (distanceUpper - distanceLower) / cols;
+// Rows per band of the parallel column reduction. The band layout depends only on the image height,
+// never on the thread count, so the merged sums are bit-identical however many threads run.
+constexpr int kReductionBandRows = 64;
 
-    for (int x = 0; x < cols; ++x) {
-        csvFile << distanceUpper - x * pixelWidth;  // Write distance
-        double averageColorGroup = 0.0; // Track average color intensity for the group
-        for (const auto& image : images) {
-            double totalColor = 0.0;
+// Average chromaticity per column of one image for each channel; channels outside the mask are empty
+using ColumnProfiles = std::array<std::vector<double>, 3>;
 
-            // Iterate through all rows in the column and calculate average color intensity
-            for (int y = 0; y < rows; ++y) {
-                assert(y < image.rows && x < image.cols && "Out-of-bounds access detected!");
-
-                cv::Vec3f pixel = image.at<cv::Vec3f>(y, x);
-                float blue = pixel[0];
-                float green = pixel[1];
-                float red = pixel[2];
-                float luminance = red + green + blue;
-                
-                // Select color based on user choice
-                float selectedColor;
-                switch (channelChoice) {
-                    case 'R': selectedColor = red; break;
-                    case 'G': selectedColor = green; break;
-                    case 'B': selectedColor = blue; break;
-                }
-                
-                totalColor += (luminance > 0) ? selectedColor / luminance : 0.0f;
-            }
+// Function to size one band's partial column sums for the channels in channelMask
+ChannelSums allocateBandSums(ColumnProfiles& band, int channelMask, int cols) {
+    ChannelSums sums;
+    for (int c = 0; c < 3; ++c) {
+        if ((channelMask >> c) & 1) {
+            band[c].assign(cols, 0.0);
+            sums.channel[c] = band[c].data();
+        }
+    }
+    return sums;
+}
 
-            double averageColor = totalColor / rows;
-            averageColorGroup += averageColor;
-            csvFile << "," << averageColor;
+// Function to add one band's partial column sums to running totals (sized on first use)
+void addBandSums(ColumnProfiles& totals, const ColumnProfiles& band, int channelMask, int cols) {
+    for (int c = 0; c < 3; ++c) {
+        if (!((channelMask >> c) & 1)) {
+            continue;
+        }
+        if (totals[c].empty()) {
+            totals[c].assign(cols, 0.0);
+        }
+        for (int x = 0; x < cols; ++x) {
+            totals[c][x] += band[c][x];
         }
+    }
+}
 
-        // Write average color across replicates
-        csvFile << "," << (averageColorGroup / images.size()) << "\n";
+// Function to turn column sums over rows into column averages
+void finishColumnAverages(ColumnProfiles& totals, int channelMask, int cols, int rows) {
+    for (int c = 0; c < 3; ++c) {
+        if (!((channelMask >> c) & 1)) {
+            continue;
+        }
+        if (totals[c].empty()) {
+            totals[c].assign(cols, 0.0);
+        }
+        for (auto& sum : totals[c]) {
+            sum /= rows;
+        }
+    }
+}
+
+// Function to merge per-band partial column sums in band order and turn them into averages over rows
+ColumnProfiles mergeBandSums(const std::vector<ColumnProfiles>& bandSums, int channelMask, int cols, int rows) {
+    ColumnProfiles profiles;
+    for (const auto& sums : bandSums) {
+        addBandSums(profiles, sums, channelMask, cols);
+    }
+    finishColumnAverages(profiles, channelMask, cols, rows);
+    return profiles;
+}
+
+// Function to reduce an image to its average chromaticity per column for every channel in channelMask.
+// The kernel for the channel mask and the reducer for the pixel depth are chosen once per image. The
+// image is then split into fixed row bands that are reduced in parallel, each into its own partial
+// column sums; within a band rows are read sequentially into arrays of length cols that stay in cache.
+// The partials are merged in band order.
+// With rgbOrder (a mapped TIFF) the image is read in place: 8/16-bit channel sums do not depend on the
+// order, so the swapped channels are reduced and their profiles swapped back; float rows are reordered
+// chunk by chunk on the way into the kernel.
+ColumnProfiles computeColumnProfiles(const cv::Mat& image, int channelMask, bool rgbOrder = false) {
+    static const SimdLevel simdLevel = detectSimdLevel();
+    assert(image.channels() == 3 && "Column reduction expects 3-channel BGR images!");
+
+    if (rgbOrder && (image.depth() == CV_8U || image.depth() == CV_16U)) {
+        ColumnProfiles profiles = computeColumnProfiles(image, swapRedBlueBits(channelMask));
+        std::swap(profiles[0], profiles[2]);
+        return profiles;
+    }
+    cv::Mat source = image;
+    ChromaticityRowsReducer reduceRows = selectChromaticityRowsReducer(image.depth());
+    if (!reduceRows) {
+        image.convertTo(source, CV_32F);
+        reduceRows = accumulateChromaticityRows<float>;
+    }
+    if (rgbOrder) {
+        reduceRows = accumulateChromaticityRowsFromRGB;
+    }
+    ChromaticityRowKernel accumulateRow = selectChromaticityRowKernel(simdLevel, channelMask);
+
+    int bandCount = (source.rows + kReductionBandRows - 1) / kReductionBandRows;
+    std::vector<ColumnProfiles> bandSums(bandCount);
+
+    cv::parallel_for_(cv::Range(0, bandCount), [&](const cv::Range& range) {
+        for (int band = range.start; band < range.end; ++band) {
+            ChannelSums sums = allocateBandSums(bandSums[band], channelMask, source.cols);
+            int rowEnd = std::min(source.rows, (band + 1) * kReductionBandRows);
+            reduceRows(source, band * kReductionBandRows, rowEnd, accumulateRow, sums);
+        }
+    });
+
+    return mergeBandSums(bandSums, channelMask, source.cols, source.rows);
+}
+
+// Buffered CSV output: numbers are formatted with std::to_chars, which ignores the locale and stream
+// state, into one large buffer that goes to the file in big chunks
+class CsvWriter {
+public:
+    // precision is the number of significant digits (as printf's %g), or 0 for the shortest text that
+    // reads back as the same double
+    CsvWriter(std::ofstream& output, int precision) : file(output), precision(precision), buffer(kBufferSize) {}
+
+    ~CsvWriter() {
+        flush();
+    }
+
+    void write(std::string_view text) {
+        reserve(text.size());
+        std::memcpy(buffer.data() + used, text.data(), text.size());
+        used += text.size();
+    }
+
+    void write(double value) {
+        reserve(kMaxNumberLength);
+        char* begin = buffer.data() + used;
+        char* end = buffer.data() + buffer.size();
+        std::to_chars_result result = precision > 0
+            ? std::to_chars(begin, end, value, std::chars_format::general, precision)
+            : std::to_chars(begin, end, value);
+        used = static_cast<size_t>(result.ptr - buffer.data());
+    }
+
+    void flush() {
+        file.write(buffer.data(), static_cast<std::streamsize>(used));
+        used = 0;
+    }
+
+private:
+    static constexpr size_t kBufferSize = 1 << 20;
+    static constexpr size_t kMaxNumberLength = 32;  // longest double at up to 17 significant digits
+
+    void reserve(size_t size) {
+        if (used + size > buffer.size()) {
+            flush();
+            if (size > buffer.size()) {
+                buffer.resize(size);
+            }
+        }
+    }
+
+    std::ofstream& file;
+    int precision;
+    std::vector<char> buffer;
+    size_t used = 0;
+};
+
+// Function to write per-replicate column profiles and their average to a CSV file. The default precision
+// of 6 significant digits gives the same text as the default std::ostream formatting.
+bool writeProfileCSV(const std::string& csvFilePath, char channelChoice, double distanceUpper, double distanceLower,
+                     const std::vector<std::vector<double>>& profiles, int precision) {
+    StageTimer timer(Stage::CsvWrite);
+    timer.trace.label = &csvFilePath;
+    std::ofstream csvFile(csvFilePath);
+    if (!csvFile.is_open()) {
+        std::cerr << "Error: Could not create CSV file: " << csvFilePath << std::endl;
+        return false;
+    }
+
+    if (logEnabled(LogLevel::Debug)) {
+        std::cout << "Writing CSV to: " << csvFilePath << std::endl;
+    }
+
+    // Update CSV headers based on channel
+    CsvWriter csv(csvFile, precision);
+    std::string channelName = getChannelName(channelChoice);
+    csv.write("Distance (cm)");
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        csv.write("," + channelName + " R" + std::to_string(i + 1));
+    }
+    csv.write(",Average " + channelName + "\n");
+
+    int cols = static_cast<int>(profiles[0].size());
+    double pixelWidth = (distanceUpper - distanceLower) / cols;
+
+    for (int x = 0; x < cols; ++x) {
+        csv.write(distanceUpper - x * pixelWidth);  // Write distance
+        double averageColorGroup = 0.0; // Track average color intensity for the group
+        for (const auto& profile : profiles) {
+            averageColorGroup += profile[x];
+            csv.write(",");
+            csv.write(profile[x]);
+        }
+
+        // Write average color across replicates
+        csv.write(",");
+        csv.write(averageColorGroup / profiles.size());
+        csv.write("\n");
+    }
+
+    csv.flush();
+    timer.bytes = static_cast<double>(csvFile.tellp());
+    csvFile.close();
+    if (!csvFile) {
+        std::cerr << "Error: Could not write CSV file: " << csvFilePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to lay out the columns of a profile CSV as one column-major table of doubles: the distance,
+// each replicate, then the average, computed exactly as writeProfileCSV computes them
+std::vector<double> buildProfileTable(double distanceUpper, double distanceLower,
+                                      const std::vector<std::vector<double>>& profiles) {
+    int cols = static_cast<int>(profiles[0].size());
+    double pixelWidth = (distanceUpper - distanceLower) / cols;
+    std::vector<double> table(static_cast<size_t>(cols) * (profiles.size() + 2));
+    double* distance = table.data();
+    double* average = table.data() + static_cast<size_t>(cols) * (profiles.size() + 1);
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        std::copy(profiles[i].begin(), profiles[i].end(), table.data() + static_cast<size_t>(cols) * (i + 1));
+    }
+    for (int x = 0; x < cols; ++x) {
+        distance[x] = distanceUpper - x * pixelWidth;
+        double averageColorGroup = 0.0;
+        for (const auto& profile : profiles) {
+            averageColorGroup += profile[x];
+        }
+        average[x] = averageColorGroup / profiles.size();
+    }
+    return table;
+}
+
+// Function to write a profile table as a NumPy .npy file: a rows x columns float64 array in Fortran
+// (column-major) order, so np.load returns the CSV's columns without parsing or copying
+bool writeProfileNpy(const std::string& npyFilePath, const std::vector<double>& table, size_t rows, size_t columns) {
+    StageTimer timer(Stage::BinaryWrite);
+    timer.trace.label = &npyFilePath;
+    std::string header = std::string("{'descr': '") + (std::endian::native == std::endian::little ? '<' : '>') +
+                         "f8', 'fortran_order': True, 'shape': (" + std::to_string(rows) + ", " +
+                         std::to_string(columns) + "), }";
+    // The magic string, version 1.0 and header length take 10 bytes; the header is padded with spaces and
+    // ends in a newline so that the data starts on a 64-byte boundary
+    size_t dataOffset = (10 + header.size() + 1 + 63) / 64 * 64;
+    header.append(dataOffset - 10 - header.size() - 1, ' ');
+    header += '\n';
+
+    std::ofstream npyFile(npyFilePath, std::ios::binary);
+    if (!npyFile.is_open()) {
+        std::cerr << "Error: Could not create NumPy file: " << npyFilePath << std::endl;
+        return false;
+    }
+    const char headerLength[2] = {static_cast<char>(header.size() & 0xFF), static_cast<char>(header.size() >> 8)};
+    npyFile.write("\x93NUMPY\x01\x00", 8);
+    npyFile.write(headerLength, 2);
+    npyFile.write(header.data(), static_cast<std::streamsize>(header.size()));
+    npyFile.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(double)));
+    timer.bytes = static_cast<double>(npyFile.tellp());
+    npyFile.close();
+    if (!npyFile) {
+        std::cerr << "Error: Could not write NumPy file: " << npyFilePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// MAT-file Level 5 data types and array class used by writeProfileMat
+constexpr uint32_t kMatInt8 = 1;
+constexpr uint32_t kMatInt32 = 5;
+constexpr uint32_t kMatUInt32 = 6;
+constexpr uint32_t kMatDouble = 9;
+constexpr uint32_t kMatMatrix = 14;
+constexpr uint32_t kMatDoubleClass = 6;
+
+// Function to append a MAT-file data element: type and byte count tags, then the data padded to 8 bytes
+void appendMatElement(std::string& buffer, uint32_t type, const void* data, size_t size) {
+    uint32_t tag[2] = {type, static_cast<uint32_t>(size)};
+    buffer.append(reinterpret_cast<const char*>(tag), sizeof(tag));
+    buffer.append(static_cast<const char*>(data), size);
+    buffer.append((8 - size % 8) % 8, '\0');
+}
+
+// Function to append a named rows x cols double matrix (column-major data) as a MAT-file variable
+void appendMatDoubleMatrix(std::string& buffer, const std::string& name, const double* data, size_t rows, size_t cols) {
+    std::string matrix;
+    uint32_t arrayFlags[2] = {kMatDoubleClass, 0};
+    int32_t dimensions[2] = {static_cast<int32_t>(rows), static_cast<int32_t>(cols)};
+    appendMatElement(matrix, kMatUInt32, arrayFlags, sizeof(arrayFlags));
+    appendMatElement(matrix, kMatInt32, dimensions, sizeof(dimensions));
+    appendMatElement(matrix, kMatInt8, name.data(), name.size());
+    appendMatElement(matrix, kMatDouble, data, rows * cols * sizeof(double));
+    appendMatElement(buffer, kMatMatrix, matrix.data(), matrix.size());
+}
+
+// Function to write a profile table as an uncompressed MATLAB Level-5 .mat file holding the variables
+// distance (rows x 1), profiles (rows x replicates) and average (rows x 1), for load() without parsing
+bool writeProfileMat(const std::string& matFilePath, const std::vector<double>& table, size_t rows, size_t replicates) {
+    StageTimer timer(Stage::BinaryWrite);
+    timer.trace.label = &matFilePath;
+    // 116 bytes of descriptive text, 8 bytes of subsystem data offset (none), version 0x0100, and the
+    // characters 'I' 'M' written as a native 16-bit value, from which readers tell the byte order
+    std::string buffer = "MATLAB 5.0 MAT-file, written by DyeGradienttoCSV";
+    buffer.resize(116, ' ');
+    buffer.append(8, '\0');
+    uint16_t versionAndEndian[2] = {0x0100, static_cast<uint16_t>(('M' << 8) | 'I')};
+    buffer.append(reinterpret_cast<const char*>(versionAndEndian), sizeof(versionAndEndian));
+
+    appendMatDoubleMatrix(buffer, "distance", table.data(), rows, 1);
+    appendMatDoubleMatrix(buffer, "profiles", table.data() + rows, rows, replicates);
+    appendMatDoubleMatrix(buffer, "average", table.data() + rows * (replicates + 1), rows, 1);
+
+    std::ofstream matFile(matFilePath, std::ios::binary);
+    if (!matFile.is_open()) {
+        std::cerr << "Error: Could not create MAT file: " << matFilePath << std::endl;
+        return false;
+    }
+    matFile.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    timer.bytes = static_cast<double>(buffer.size());
+    matFile.close();
+    if (!matFile) {
+        std::cerr << "Error: Could not write MAT file: " << matFilePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to read the average column (the last one) of a profile CSV written by writeProfileCSV.
+// Returns an empty vector if the file does not exist or is malformed.
+std::vector<double> readProfileCSVAverages(const std::string& csvFilePath) {
+    std::vector<double> averages;
+    std::ifstream csvFile(csvFilePath);
+    std::string line;
+    if (!std::getline(csvFile, line)) {
+        return averages;  // no file, or no header
+    }
+    while (std::getline(csvFile, line)) {
+        size_t lastComma = line.rfind(',');
+        if (lastComma == std::string::npos) {
+            return {};
+        }
+        averages.push_back(std::strtod(line.c_str() + lastComma + 1, nullptr));
+    }
+    return averages;
+}
+
+// Function to compare a preview's average profile with the full-resolution one. Both span the same
+// distances, so full-resolution column x falls in preview column x * previewCols / fullCols; the
+// full-resolution columns in each preview column are averaged before taking the difference.
+void comparePreviewProfile(const std::vector<double>& preview, const std::vector<double>& full,
+                           double& maxError, double& meanError) {
+    size_t previewCols = preview.size();
+    std::vector<double> binned(previewCols, 0.0);
+    std::vector<int> counts(previewCols, 0);
+    for (size_t x = 0; x < full.size(); ++x) {
+        size_t column = x * previewCols / full.size();
+        binned[column] += full[x];
+        ++counts[column];
+    }
+    maxError = 0.0;
+    meanError = 0.0;
+    int compared = 0;
+    for (size_t column = 0; column < previewCols; ++column) {
+        if (counts[column] == 0) {
+            continue;
+        }
+        double error = std::abs(preview[column] - binned[column] / counts[column]);
+        maxError = std::max(maxError, error);
+        meanError += error;
+        ++compared;
+    }
+    meanError = compared > 0 ? meanError / compared : 0.0;
+}
+
+// Blur applied to each replicate before the column reduction
+enum class BlurMethod {
+    Gaussian,   // exact cv::GaussianBlur, cost grows with the radius
+    Recursive,  // Young-van Vliet recursive Gaussian, constant cost per pixel
+    Streaming   // exact Gaussian fused into the column reduction, blurred image never stored
+};
+
+// Pixel format of the aligned verification TIFFs; None skips writing them
+enum class AlignedImageFormat { None, Float32, UInt16, UInt8 };
+
+// Compression of the aligned verification TIFFs, as libtiff COMPRESSION_* codes
+enum class TiffCompression { None = 1, LZW = 5, Deflate = 8 };
+
+// Binary copies of the profile CSVs written next to them: NumPy .npy, MATLAB Level-5 .mat, or both
+enum class ProfileBinaryFormat { None, Npy, Mat, Both };
+
+// Analysis parameters shared by every RPM group of a dataset
+struct ProcessingOptions {
+    double distanceUpper = 0.0;
+    double distanceLower = 0.0;
+    char channelChoice = 'R';
+    int blurRadius = 10;
+    BlurMethod blurMethod = BlurMethod::Gaussian;
+    AlignedImageFormat alignedImageFormat = AlignedImageFormat::None;
+    TiffCompression alignedImageCompression = TiffCompression::None;
+    int alignedImageWidth = 0;  // downscale aligned images to this width (thumbnails), 0 keeps full size
+    int streamRows = 0;         // decode and reduce this many rows at a time instead of whole images, 0 = off
+    bool memoryMap = true;      // reduce uncompressed TIFF and .dgraw pixels straight from a file mapping
+    int previewScale = 1;       // decode at 1/previewScale resolution (2, 4 or 8) and write preview CSVs, 1 = off
+    bool columnCache = false;   // reuse column profiles cached in <output>/column_cache for unchanged images
+    bool incremental = true;    // only rebuild the RPM groups whose CSVs the build manifest shows to be stale
+    int csvPrecision = 6;       // significant digits of CSV values, 0 = shortest round-trip
+    ProfileBinaryFormat binaryProfiles = ProfileBinaryFormat::None;
+};
+
+// Function to get the sigma cv::GaussianBlur derives for a (2 * blurRadius + 1) kernel when sigma is 0,
+// i.e. 0.3 * ((ksize - 1) * 0.5 - 1) + 0.8
+double getGaussianSigma(int blurRadius) {
+    return 0.3 * (blurRadius - 1) + 0.8;
+}
+
+// Normalized coefficients of the Young-van Vliet recursive Gaussian:
+// w[n] = B * x[n] + b1 * w[n-1] + b2 * w[n-2] + b3 * w[n-3], applied forward and then backward
+struct RecursiveGaussianCoefficients {
+    double B, b1, b2, b3;
+};
+
+RecursiveGaussianCoefficients computeRecursiveGaussianCoefficients(double sigma) {
+    double q = (sigma >= 2.5) ? 0.98711 * sigma - 0.96330
+                              : 3.97156 - 4.14554 * std::sqrt(1.0 - 0.26891 * sigma);
+    double q2 = q * q, q3 = q2 * q;
+    double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+    double b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+    double b2 = -(1.4281 * q2 + 1.26661 * q3);
+    double b3 = 0.422205 * q3;
+    return {1.0 - (b1 + b2 + b3) / b0, b1 / b0, b2 / b0, b3 / b0};
+}
+
+// Function to run the forward and backward recursions over `count` samples spaced `stride` apart.
+// The history before the first and after the last sample is the edge value, i.e. a replicated border.
+void recursiveGaussian1D(float* data, int count, int stride, const RecursiveGaussianCoefficients& k) {
+    double w1 = data[0], w2 = w1, w3 = w1;
+    for (int i = 0; i < count; ++i) {
+        double w = k.B * data[i * stride] + k.b1 * w1 + k.b2 * w2 + k.b3 * w3;
+        data[i * stride] = static_cast<float>(w);
+        w3 = w2; w2 = w1; w1 = w;
+    }
+    double y1 = data[(count - 1) * stride], y2 = y1, y3 = y1;
+    for (int i = count - 1; i >= 0; --i) {
+        double y = k.B * data[i * stride] + k.b1 * y1 + k.b2 * y2 + k.b3 * y3;
+        data[i * stride] = static_cast<float>(y);
+        y3 = y2; y2 = y1; y1 = y;
+    }
+}
+
+// Columns (float elements) filtered together by one task of the vertical pass
+constexpr int kRecursiveBlurStripWidth = 64;
+
+// Function to blur an image with a recursive Gaussian of the given sigma. The result is CV_32F.
+// Rows are filtered in place in parallel; the vertical pass walks strips of adjacent columns down
+// the image so it still reads rows sequentially, keeping the recursion state for the strip in cache.
+cv::Mat recursiveGaussianBlur(const cv::Mat& image, double sigma) {
+    cv::Mat result = pooledMat();
+    image.convertTo(result, CV_32F);
+    RecursiveGaussianCoefficients k = computeRecursiveGaussianCoefficients(sigma);
+    int channels = result.channels();
+    int width = result.cols * channels;
+
+    cv::parallel_for_(cv::Range(0, result.rows), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; ++y) {
+            float* row = result.ptr<float>(y);
+            for (int c = 0; c < channels; ++c) {
+                recursiveGaussian1D(row + c, result.cols, channels, k);
+            }
+        }
+    });
+
+    int stripCount = (width + kRecursiveBlurStripWidth - 1) / kRecursiveBlurStripWidth;
+    cv::parallel_for_(cv::Range(0, stripCount), [&](const cv::Range& range) {
+        int rows = result.rows;
+        std::vector<double> w1(kRecursiveBlurStripWidth), w2(kRecursiveBlurStripWidth), w3(kRecursiveBlurStripWidth);
+        for (int strip = range.start; strip < range.end; ++strip) {
+            int begin = strip * kRecursiveBlurStripWidth;
+            int count = std::min(kRecursiveBlurStripWidth, width - begin);
+
+            const float* first = result.ptr<float>(0) + begin;
+            for (int i = 0; i < count; ++i) {
+                w1[i] = w2[i] = w3[i] = first[i];
+            }
+            for (int y = 0; y < rows; ++y) {
+                float* row = result.ptr<float>(y) + begin;
+                for (int i = 0; i < count; ++i) {
+                    double w = k.B * row[i] + k.b1 * w1[i] + k.b2 * w2[i] + k.b3 * w3[i];
+                    row[i] = static_cast<float>(w);
+                    w3[i] = w2[i]; w2[i] = w1[i]; w1[i] = w;
+                }
+            }
+
+            const float* last = result.ptr<float>(rows - 1) + begin;
+            for (int i = 0; i < count; ++i) {
+                w1[i] = w2[i] = w3[i] = last[i];
+            }
+            for (int y = rows - 1; y >= 0; --y) {
+                float* row = result.ptr<float>(y) + begin;
+                for (int i = 0; i < count; ++i) {
+                    double w = k.B * row[i] + k.b1 * w1[i] + k.b2 * w2[i] + k.b3 * w3[i];
+                    row[i] = static_cast<float>(w);
+                    w3[i] = w2[i]; w2[i] = w1[i]; w1[i] = w;
+                }
+            }
+        }
+    });
+    return result;
+}
+
+// Function to blur an image in place with the configured method (no-op for a radius of 0, and for
+// the streaming method, which blurs inside the column reduction)
+void applyBlur(cv::Mat& image, const ProcessingOptions& options) {
+    if (options.blurRadius <= 0 || options.blurMethod == BlurMethod::Streaming) {
+        return;
+    }
+    if (options.blurMethod == BlurMethod::Recursive) {
+        image = recursiveGaussianBlur(image, getGaussianSigma(options.blurRadius));
+    } else {
+        cv::Mat blurred = pooledMat();
+        cv::GaussianBlur(image, blurred, cv::Size(2 * options.blurRadius + 1, 2 * options.blurRadius + 1), 0);
+        image = blurred;
+    }
+}
+
+// Function to report the maximum deviation of the recursive blur from the exact Gaussian on one image,
+// both per pixel and in the resulting column chromaticity profiles
+void reportBlurDeviation(const cv::Mat& image, int blurRadius) {
+    cv::Mat exact;
+    image.convertTo(exact, CV_32F);
+    cv::GaussianBlur(exact, exact, cv::Size(2 * blurRadius + 1, 2 * blurRadius + 1), 0);
+    cv::Mat recursive = recursiveGaussianBlur(image, getGaussianSigma(blurRadius));
+
+    double minVal, maxVal;
+    cv::minMaxLoc(exact.reshape(1), &minVal, &maxVal);
+    double pixelDeviation = cv::norm(exact, recursive, cv::NORM_INF);
+
+    ColumnProfiles exactProfiles = computeColumnProfiles(exact, kAllChannelsMask);
+    ColumnProfiles recursiveProfiles = computeColumnProfiles(recursive, kAllChannelsMask);
+    double profileDeviation = 0.0;
+    for (int c = 0; c < 3; ++c) {
+        for (size_t x = 0; x < exactProfiles[c].size(); ++x) {
+            profileDeviation = std::max(profileDeviation, std::abs(exactProfiles[c][x] - recursiveProfiles[c][x]));
+        }
+    }
+
+    std::cout << "Recursive vs exact Gaussian blur (radius " << blurRadius << "): max pixel deviation "
+              << pixelDeviation << " (" << (maxVal > 0 ? 100.0 * pixelDeviation / maxVal : 0.0)
+              << "% of max), max chromaticity profile deviation " << profileDeviation << std::endl;
+}
+
+// Function to blur one source row horizontally with a Gaussian kernel, writing only the first `cols`
+// BGR pixels as float. Pixels beyond the source edges are reflected (BORDER_REFLECT_101) like
+// cv::GaussianBlur, and pixels past `cols` but inside the source are used as real context.
+template <typename T>
+void horizontalGaussianRow(const cv::Mat& source, int y, int cols, const std::vector<float>& kernel,
+                           float* padded, float* out) {
+    int radius = static_cast<int>(kernel.size()) / 2;
+    const T* row = source.ptr<T>(y);
+    for (int i = 0; i < cols + 2 * radius; ++i) {
+        int x = i - radius;
+        if (x < 0 || x >= source.cols) {
+            x = cv::borderInterpolate(x, source.cols, cv::BORDER_REFLECT_101);
+        }
+        for (int c = 0; c < 3; ++c) {
+            padded[3 * i + c] = static_cast<float>(row[3 * x + c]);
+        }
+    }
+
+    std::fill(out, out + 3 * cols, 0.0f);
+    for (size_t k = 0; k < kernel.size(); ++k) {
+        const float* in = padded + 3 * k;
+        float weight = kernel[k];
+        for (int j = 0; j < 3 * cols; ++j) {
+            out[j] += weight * in[j];
+        }
+    }
+}
+
+using HorizontalGaussianRowFilter = void (*)(const cv::Mat& source, int y, int cols, const std::vector<float>& kernel,
+                                             float* padded, float* out);
+
+// Function to pick the horizontal row filter for an image depth, or nullptr for unsupported depths
+HorizontalGaussianRowFilter selectHorizontalGaussianRowFilter(int depth) {
+    switch (depth) {
+        case CV_8U: return horizontalGaussianRow<uchar>;
+        case CV_16U: return horizontalGaussianRow<ushort>;
+        case CV_32F: return horizontalGaussianRow<float>;
+    }
+    return nullptr;
+}
+
+// Function to get the normalized weights of the (2 * blurRadius + 1) Gaussian cv::GaussianBlur uses
+std::vector<float> getGaussianKernelWeights(int blurRadius) {
+    int kernelSize = 2 * blurRadius + 1;
+    cv::Mat kernelMat = cv::getGaussianKernel(kernelSize, 0, CV_32F);
+    return std::vector<float>(kernelMat.ptr<float>(0), kernelMat.ptr<float>(0) + kernelSize);
+}
+
+// Function to get the rows per band of the fused blur and reduction. Bands span at least four kernel
+// heights so the halo rows each band filters again stay cheap.
+int getBlurredBandRows(int kernelSize) {
+    return std::max(4 * kReductionBandRows, 4 * kernelSize);
+}
+
+// Function to produce output row y of the vertical Gaussian pass from a rolling window of kernel-height
+// horizontally blurred rows, where source row r lives in slot r % kernel size and rows y - radius ..
+// y + radius are all present. Rows beyond the image edges are reflected (BORDER_REFLECT_101).
+void verticalGaussianRow(const std::vector<float>& window, int y, int imageRows, int cols,
+                         const std::vector<float>& kernel, float* blurred) {
+    int kernelSize = static_cast<int>(kernel.size());
+    int radius = kernelSize / 2;
+    std::fill(blurred, blurred + 3 * cols, 0.0f);
+    for (int k = 0; k < kernelSize; ++k) {
+        int sourceRow = cv::borderInterpolate(y + k - radius, imageRows, cv::BORDER_REFLECT_101);
+        const float* in = window.data() + static_cast<size_t>(sourceRow % kernelSize) * 3 * cols;
+        float weight = kernel[k];
+        for (int j = 0; j < 3 * cols; ++j) {
+            blurred[j] += weight * in[j];
+        }
+    }
+}
+
+// Function to reduce the top-left rows x cols region of a source image, blurred with the exact
+// (2 * blurRadius + 1) Gaussian, to its average chromaticity per column without ever storing the
+// blurred image. Each band of output rows keeps a rolling window of kernel-height horizontally blurred
+// rows; as soon as the window covers an output row, the vertical pass produces that row and feeds it
+// straight into the column accumulators. Working memory is O(kernel height x cols) per thread.
+// Rows and columns outside the region are used as blur context, matching a blur of the full frame
+// followed by a crop. The arithmetic is single-precision float throughout, so results can differ from
+// cv::GaussianBlur on 8-bit input, which rounds the blurred image back to 8 bits.
+ColumnProfiles computeBlurredColumnProfiles(const cv::Mat& image, int rows, int cols, int blurRadius, int channelMask,
+                                            bool rgbOrder = false) {
+    static const SimdLevel simdLevel = detectSimdLevel();
+    assert(image.channels() == 3 && "Column reduction expects 3-channel BGR images!");
+    assert(rows <= image.rows && cols <= image.cols && "Reduced region must lie inside the image!");
+
+    cv::Mat source = image;
+    HorizontalGaussianRowFilter filterRow = selectHorizontalGaussianRowFilter(image.depth());
+    if (!filterRow) {
+        image.convertTo(source, CV_32F);
+        filterRow = horizontalGaussianRow<float>;
+    }
+    ChromaticityRowKernel accumulateRow = selectChromaticityRowKernel(simdLevel, channelMask);
+
+    std::vector<float> kernel = getGaussianKernelWeights(blurRadius);
+    int kernelSize = static_cast<int>(kernel.size());
+    int bandRows = getBlurredBandRows(kernelSize);
+    int bandCount = (rows + bandRows - 1) / bandRows;
+    std::vector<ColumnProfiles> bandSums(bandCount);
+
+    cv::parallel_for_(cv::Range(0, bandCount), [&](const cv::Range& range) {
+        std::vector<float> window(static_cast<size_t>(kernelSize) * 3 * cols);
+        std::vector<float> padded(3 * (cols + 2 * blurRadius));
+        std::vector<float> blurred(3 * cols);
+        for (int band = range.start; band < range.end; ++band) {
+            ChannelSums sums = allocateBandSums(bandSums[band], channelMask, cols);
+            int rowBegin = band * bandRows;
+            int rowEnd = std::min(rows, rowBegin + bandRows);
+            int nextSourceRow = std::max(0, rowBegin - blurRadius);
+
+            for (int y = rowBegin; y < rowEnd; ++y) {
+                // Source row r lives in window slot r % kernelSize; rows y - radius .. y + radius are all present
+                int lastSourceRow = std::min(image.rows - 1, y + blurRadius);
+                for (; nextSourceRow <= lastSourceRow; ++nextSourceRow) {
+                    filterRow(source, nextSourceRow, cols, kernel, padded.data(),
+                              window.data() + static_cast<size_t>(nextSourceRow % kernelSize) * 3 * cols);
+                }
+
+                verticalGaussianRow(window, y, image.rows, cols, kernel, blurred.data());
+                if (rgbOrder) {
+                    for (int x = 0; x < cols; ++x) {
+                        std::swap(blurred[3 * x], blurred[3 * x + 2]);
+                    }
+                }
+                accumulateRow(blurred.data(), cols, sums);
+            }
+        }
+    });
+
+    return mergeBandSums(bandSums, channelMask, cols, rows);
+}
+
+// Fixed-size pool of worker threads running queued tasks in submission order
+class ThreadPool {
+public:
+    explicit ThreadPool(int threadCount) {
+        for (int i = 0; i < std::max(1, threadCount); ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template <typename Task>
+    auto submit(Task task) -> std::future<decltype(task())> {
+        using Result = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        std::future<Result> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace([packaged] { (*packaged)(); });
+        }
+        condition.notify_one();
+        return result;
+    }
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+private:
+    void workerLoop() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+};
+
+// Queue with a fixed capacity between two pipeline stages. push blocks while the queue is full,
+// which holds back the producing stage and caps the memory held between stages.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(std::max<size_t>(1, capacity)) {}
+
+    // Blocks while the queue is full; returns false if the queue has been closed
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Blocks while the queue is empty; returns std::nullopt once it is closed and drained
+    std::optional<T> pop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return std::nullopt;
+        }
+        T item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return item;
+    }
+
+    // Wakes all waiters; pop keeps returning the remaining items before reporting the end
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    size_t capacity;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable notEmpty, notFull;
+    bool closed = false;
+};
+
+// Read-only mapping of a whole file. The pages are those of the OS page cache, so an image that is
+// already cached is reduced without being read or copied
+class MappedFile {
+public:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+#else
+        munmap(const_cast<uchar*>(data), size);
+#endif
+    }
+
+    // Function to map a file, or return nullptr if it cannot be opened or is empty
+    static std::shared_ptr<const MappedFile> open(const std::string& path) {
+        std::shared_ptr<MappedFile> file(new MappedFile);
+#ifdef _WIN32
+        HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) {
+            return nullptr;
+        }
+        LARGE_INTEGER fileSize{};
+        HANDLE mapping = nullptr;
+        if (GetFileSizeEx(handle, &fileSize) && fileSize.QuadPart > 0) {
+            mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        }
+        CloseHandle(handle);
+        if (!mapping) {
+            return nullptr;
+        }
+        file->data = static_cast<const uchar*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        file->size = static_cast<size_t>(fileSize.QuadPart);
+        CloseHandle(mapping);
+#else
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            return nullptr;
+        }
+        struct stat info{};
+        void* address = MAP_FAILED;
+        if (fstat(descriptor, &info) == 0 && info.st_size > 0) {
+            address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+        }
+        ::close(descriptor);
+        if (address == MAP_FAILED) {
+            return nullptr;
+        }
+        file->data = static_cast<const uchar*>(address);
+        file->size = static_cast<size_t>(info.st_size);
+#endif
+        return file->data ? file : nullptr;
+    }
+
+    const uchar* data = nullptr;
+    size_t size = 0;
+
+private:
+    MappedFile() = default;
+};
+
+// Function to read an unsigned 16 or 32-bit TIFF value stored in the file's byte order
+uint32_t readTiffValue(const uchar* bytes, int width, bool bigEndian) {
+    uint32_t value = 0;
+    for (int k = 0; k < width; ++k) {
+        value |= static_cast<uint32_t>(bytes[bigEndian ? width - 1 - k : k]) << (8 * k);
+    }
+    return value;
+}
+
+// Function to wrap the pixels of a mapped TIFF in a Mat header without copying. Only baseline TIFFs
+// whose pixels already form one contiguous, row-major RGB image qualify: uncompressed, chunky,
+// stripped with the strips back to back, and 8-bit, 16-bit or 32-bit float samples (multi-byte samples
+// only in the host's byte order). Anything else returns an empty Mat and is decoded normally. The Mat
+// holds the samples in file order, i.e. RGB rather than OpenCV's BGR.
+cv::Mat mapTiffPixels(const MappedFile& file) {
+    const uchar* data = file.data;
+    if (file.size < 8 || !(data[0] == data[1] && (data[0] == 'I' || data[0] == 'M'))) {
+        return {};
+    }
+    bool bigEndian = data[0] == 'M';
+    if (readTiffValue(data + 2, 2, bigEndian) != 42) {
+        return {};  // BigTIFF (43) and anything else
+    }
+    uint64_t ifdOffset = readTiffValue(data + 4, 4, bigEndian);
+    if (ifdOffset + 2 > file.size) {
+        return {};
+    }
+    uint32_t entryCount = readTiffValue(data + ifdOffset, 2, bigEndian);
+    if (ifdOffset + 2 + 12ull * entryCount > file.size) {
+        return {};
+    }
+
+    // Function to read element k of an entry's SHORT or LONG values, inline or at their offset
+    auto entryValue = [&](const uchar* entry, uint32_t k, uint32_t& value) {
+        uint32_t type = readTiffValue(entry + 2, 2, bigEndian);
+        uint64_t count = readTiffValue(entry + 4, 4, bigEndian);
+        int width = type == 3 ? 2 : type == 4 ? 4 : 0;
+        if (width == 0 || k >= count) {
+            return false;
+        }
+        const uchar* values = entry + 8;
+        if (count * width > 4) {
+            uint64_t offset = readTiffValue(entry + 8, 4, bigEndian);
+            if (offset + count * width > file.size) {
+                return false;
+            }
+            values = data + offset;
+        }
+        value = readTiffValue(values + static_cast<size_t>(k) * width, width, bigEndian);
+        return true;
+    };
+
+    uint32_t width = 0, height = 0, bitsPerSample = 1, compression = 1, photometric = 0, samplesPerPixel = 1;
+    uint32_t rowsPerStrip = std::numeric_limits<uint32_t>::max(), planarConfig = 1, sampleFormat = 1;
+    const uchar* stripOffsets = nullptr;
+    for (uint32_t e = 0; e < entryCount; ++e) {
+        const uchar* entry = data + ifdOffset + 2 + 12ull * e;
+        uint32_t tag = readTiffValue(entry, 2, bigEndian);
+        uint32_t value = 0;
+        bool valid = true;
+        switch (tag) {
+            case 256: valid = entryValue(entry, 0, width); break;
+            case 257: valid = entryValue(entry, 0, height); break;
+            case 258:  // one value per sample, which must all agree
+                valid = entryValue(entry, 0, bitsPerSample);
+                for (uint32_t k = 1; valid && entryValue(entry, k, value); ++k) {
+                    valid = value == bitsPerSample;
+                }
+                break;
+            case 259: valid = entryValue(entry, 0, compression); break;
+            case 262: valid = entryValue(entry, 0, photometric); break;
+            case 273: stripOffsets = entry; break;
+            case 277: valid = entryValue(entry, 0, samplesPerPixel); break;
+            case 278: valid = entryValue(entry, 0, rowsPerStrip); break;
+            case 284: valid = entryValue(entry, 0, planarConfig); break;
+            case 322: return {};  // tiled
+            case 339: valid = entryValue(entry, 0, sampleFormat); break;
+            default: break;
+        }
+        if (!valid) {
+            return {};
+        }
+    }
+    if (width == 0 || height == 0 || compression != 1 || photometric != 2 || samplesPerPixel != 3 ||
+        planarConfig != 1 || !stripOffsets) {
+        return {};
+    }
+
+    int depth;
+    if (bitsPerSample == 8 && sampleFormat == 1) {
+        depth = CV_8U;
+    } else if (bitsPerSample == 16 && sampleFormat == 1) {
+        depth = CV_16U;
+    } else if (bitsPerSample == 32 && sampleFormat == 3) {
+        depth = CV_32F;
+    } else {
+        return {};
+    }
+    if (bitsPerSample > 8 && bigEndian != (std::endian::native == std::endian::big)) {
+        return {};
+    }
+
+    // The strips must follow each other exactly, so that row y starts at firstOffset + y * stride
+    uint64_t stride = static_cast<uint64_t>(width) * 3 * (bitsPerSample / 8);
+    uint64_t stripRows = std::min(rowsPerStrip, height);
+    uint64_t stripCount = (height + stripRows - 1) / stripRows;
+    uint32_t firstOffset = 0, offset = 0;
+    if (!entryValue(stripOffsets, 0, firstOffset) || firstOffset % (bitsPerSample / 8) != 0 ||
+        firstOffset + stride * height > file.size) {
+        return {};
+    }
+    for (uint32_t strip = 1; strip < stripCount; ++strip) {
+        if (!entryValue(stripOffsets, strip, offset) || offset != firstOffset + strip * stripRows * stride) {
+            return {};
+        }
+    }
+    if (height > static_cast<uint32_t>(std::numeric_limits<int>::max()) ||
+        width > static_cast<uint32_t>(std::numeric_limits<int>::max() / 3)) {
+        return {};
+    }
+    return cv::Mat(static_cast<int>(height), static_cast<int>(width), CV_MAKETYPE(depth, 3),
+                   const_cast<uchar*>(data + firstOffset), static_cast<size_t>(stride));
+}
+
+// Headered raw format (.dgraw): the magic "DYERAW01", then little-endian uint32 width, height, channels
+// (always 3), OpenCV depth (CV_8U = 0, CV_16U = 2 or CV_32F = 5) and offset of the pixel data, and 4
+// reserved bytes. The pixels are unpadded, interleaved BGR rows in little-endian byte order.
+constexpr size_t kRawHeaderSize = 32;
+
+// Function to wrap the pixels of a mapped .dgraw file in a Mat header without copying, or return an
+// empty Mat if the header is invalid
+cv::Mat mapRawPixels(const MappedFile& file) {
+    const uchar* data = file.data;
+    if (file.size < kRawHeaderSize || std::memcmp(data, "DYERAW01", 8) != 0) {
+        return {};
+    }
+    uint32_t width = readTiffValue(data + 8, 4, false);
+    uint32_t height = readTiffValue(data + 12, 4, false);
+    uint32_t channels = readTiffValue(data + 16, 4, false);
+    uint32_t depth = readTiffValue(data + 20, 4, false);
+    uint32_t offset = readTiffValue(data + 24, 4, false);
+    if ((depth != CV_8U && depth != CV_16U && depth != CV_32F) || channels != 3 || width == 0 || height == 0 ||
+        height > static_cast<uint32_t>(std::numeric_limits<int>::max()) ||
+        width > static_cast<uint32_t>(std::numeric_limits<int>::max() / 3)) {
+        return {};
+    }
+    uint64_t sampleSize = CV_ELEM_SIZE1(depth);
+    uint64_t stride = static_cast<uint64_t>(width) * 3 * sampleSize;
+    if (offset < kRawHeaderSize || offset % sampleSize != 0 || offset + stride * height > file.size ||
+        (sampleSize > 1 && std::endian::native != std::endian::little)) {
+        return {};
+    }
+    return cv::Mat(static_cast<int>(height), static_cast<int>(width), CV_MAKETYPE(static_cast<int>(depth), 3),
+                   const_cast<uchar*>(data + offset), static_cast<size_t>(stride));
+}
+
+// Function to get a filename's extension in lower case
+std::string getLowerCaseExtension(const std::string& filename) {
+    std::string extension = fs::path(filename).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    return extension;
+}
+
+// A replicate image as handed from the decode pool to the processing stage
+struct DecodedImage {
+    std::string filename;
+    cv::Mat image;                              // empty if the file could not be decoded
+    bool rgbOrder = false;                      // channels stored as RGB (a mapped TIFF) instead of BGR
+    std::shared_ptr<const MappedFile> mapping;  // keeps a memory-mapped image's pixels alive
+};
+
+// Function to map an uncompressed TIFF or a .dgraw file and wrap its pixels without copying. Returns an
+// empty image for files it cannot map, which are then decoded normally.
+DecodedImage mapImageFile(const std::string& path, const std::string& filename) {
+    DecodedImage mapped{filename, {}, false, MappedFile::open(path)};
+    if (mapped.mapping) {
+        bool raw = getLowerCaseExtension(filename) == ".dgraw";
+        mapped.image = raw ? mapRawPixels(*mapped.mapping) : mapTiffPixels(*mapped.mapping);
+        mapped.rgbOrder = !raw;
+    }
+    if (mapped.image.empty()) {
+        mapped.mapping.reset();
+    }
+    return mapped;
+}
+
+// Function to get the imdecode flags that decode at 1/previewScale resolution; JPEGs are scaled in the
+// DCT domain, other formats are decoded whole and resized by OpenCV
+int getPreviewDecodeFlags(int previewScale) {
+    switch (previewScale) {
+        case 2: return cv::IMREAD_ANYDEPTH | cv::IMREAD_REDUCED_COLOR_2;
+        case 4: return cv::IMREAD_ANYDEPTH | cv::IMREAD_REDUCED_COLOR_4;
+        case 8: return cv::IMREAD_ANYDEPTH | cv::IMREAD_REDUCED_COLOR_8;
+        default: return cv::IMREAD_ANYDEPTH | cv::IMREAD_COLOR;
+    }
+}
+
+// Function to decode one image file; safe to call from any thread. With memoryMap, uncompressed TIFFs
+// and .dgraw files are mapped instead, and the returned image points into the mapping. With a
+// previewScale above 1 the image is decoded at that fraction of its resolution.
+DecodedImage decodeImage(const std::string& folderPath, const std::string& filename, const ProcessingOptions& options) {
+    if (logEnabled(LogLevel::Debug)) {
+        std::cout << "Loading image: " << filename << std::endl;
+    }
+    StageTimer timer(Stage::Decode);
+    timer.trace.label = &filename;
+
+    std::string extension = getLowerCaseExtension(filename);
+    if (extension == ".dgraw" || (options.memoryMap && (extension == ".tif" || extension == ".tiff"))) {
+        DecodedImage mapped = mapImageFile(folderPath + "/" + filename, filename);
+        if (!mapped.image.empty() && options.previewScale > 1) {
+            // Strided read: nearest-neighbour sampling touches only every previewScale-th row of the mapping
+            cv::Mat preview = pooledMat();
+            cv::resize(mapped.image, preview, cv::Size(std::max(1, mapped.image.cols / options.previewScale),
+                                                       std::max(1, mapped.image.rows / options.previewScale)),
+                       0, 0, cv::INTER_NEAREST);
+            mapped.image = preview;
+            mapped.mapping.reset();
+        } else if (!mapped.image.empty() && !options.memoryMap) {
+            // .dgraw has no other decoder; copy the pixels so that no mapping is held
+            cv::Mat image = pooledMat();
+            mapped.image.copyTo(image);
+            mapped.image = image;
+            mapped.mapping.reset();
+        }
+        if (!mapped.image.empty() || extension == ".dgraw") {
+            timer.addImage(mapped.image);
+            if (mapped.image.empty()) {
+                std::cerr << "Error: Could not load image: " << filename << std::endl;
+            } else if (logEnabled(LogLevel::Debug) && mapped.mapping) {
+                std::cout << "Memory-mapped image: " << filename << std::endl;
+            }
+            return mapped;
+        }
+    }
+
+    // Read the file into this thread's reusable buffer and decode into a pooled image.
+    // IMREAD_ANYDEPTH keeps 16-bit and float data, IMREAD_(REDUCED_)COLOR guarantees 3-channel BGR
+    thread_local std::vector<uchar> fileBuffer;
+    cv::Mat image = pooledMat();
+    std::ifstream file(folderPath + "/" + filename, std::ios::binary | std::ios::ate);
+    if (file) {
+        std::streamsize size = file.tellg();
+        file.seekg(0);
+        fileBuffer.resize(static_cast<size_t>(std::max<std::streamsize>(size, 0)));
+        if (size > 0 && file.read(reinterpret_cast<char*>(fileBuffer.data()), size)) {
+            cv::imdecode(fileBuffer, getPreviewDecodeFlags(options.previewScale), &image);
+        }
+    }
+    timer.addImage(image);
+    if (image.empty()) {
+        std::cerr << "Error: Could not load image: " << filename << std::endl;
+    }
+    return {filename, image, false, nullptr};
+}
+
+// Function to get the replicate filenames of one RPM group, in replicate order
+std::vector<std::string> getReplicateFilenames(const FilenameIndex& index, const std::string& identifier, int rpm) {
+    std::vector<std::string> replicates;
+    const auto* groups = findRPMGroups(index, identifier);
+    if (groups && groups->count(rpm)) {
+        for (const auto& replicate : groups->at(rpm)) {
+            replicates.push_back(replicate.second);
+        }
+    }
+    return replicates;
+}
+
+// One aligned replicate waiting to be written for verification
+struct AlignedImageJob {
+    std::string filename;
+    cv::Mat image;    // shares its data with the reduction, so it is only read
+    int sourceDepth;  // depth of the decoded image, whose full-scale value maps to 8/16-bit white
+    bool rgbOrder = false;                      // channels stored as RGB (a mapped TIFF) instead of BGR
+    std::shared_ptr<const MappedFile> mapping;  // keeps a memory-mapped image's pixels alive
+    int rpm = 0;
+};
+
+// Function to convert an aligned image to the requested verification format and size
+cv::Mat prepareAlignedImage(const AlignedImageJob& job, const ProcessingOptions& options) {
+    cv::Mat image = job.image;
+    if (options.alignedImageWidth > 0 && options.alignedImageWidth < image.cols) {
+        int height = std::max(1, static_cast<int>(std::lround(static_cast<double>(image.rows) *
+                                                              options.alignedImageWidth / image.cols)));
+        cv::Mat resized = pooledMat();
+        cv::resize(image, resized, cv::Size(options.alignedImageWidth, height), 0, 0, cv::INTER_AREA);
+        image = resized;
+    }
+    if (job.rgbOrder) {
+        cv::Mat bgr = pooledMat();
+        cv::cvtColor(image, bgr, cv::COLOR_RGB2BGR);
+        image = bgr;
+    }
+
+    // Float sources are taken to be normalized to [0, 1]
+    double sourceScale = job.sourceDepth == CV_8U ? 255.0 : job.sourceDepth == CV_16U ? 65535.0 : 1.0;
+    cv::Mat saveImage = pooledMat();
+    switch (options.alignedImageFormat) {
+        case AlignedImageFormat::UInt16:
+            image.convertTo(saveImage, CV_16U, 65535.0 / sourceScale);
+            break;
+        case AlignedImageFormat::UInt8:
+            image.convertTo(saveImage, CV_8U, 255.0 / sourceScale);
+            break;
+        default:
+            image.convertTo(saveImage, CV_32F);  // Keep as float
+            break;
+    }
+    return saveImage;
+}
+
+// Background writer for the aligned verification TIFFs. Conversion, downscaling, compression and
+// file I/O all run on its own thread; the processing stage only queues cv::Mat headers and blocks
+// once `capacity` images are waiting, so a slow disk holds the pipeline back instead of growing memory.
+class AlignedImageWriter {
+public:
+    AlignedImageWriter(const ProcessingOptions& options, size_t capacity)
+        : options(options), queue(capacity), worker([this] { run(); }) {}
+
+    // Writes everything still queued before returning
+    ~AlignedImageWriter() {
+        finish();
+    }
+
+    // Function to write everything still queued and return the RPM groups with an image that could not be saved
+    std::set<int> finish() {
+        queue.close();
+        if (worker.joinable()) {
+            worker.join();
+        }
+        return failedRPMs;
+    }
+
+    void write(AlignedImageJob job) {
+        queue.push(std::move(job));
+    }
+
+private:
+    void run() {
+        while (std::optional<AlignedImageJob> job = queue.pop()) {
+            StageTimer timer(Stage::AlignedWrite);
+            timer.trace.label = &job->filename;
+            timer.addImage(job->image);
+            cv::Mat saveImage = prepareAlignedImage(*job, options);
+            if (logEnabled(LogLevel::Debug)) {
+                std::cout << "Saving aligned image to: " << job->filename << ", type: " << saveImage.type()
+                          << ", channels: " << saveImage.channels() << std::endl;
+            }
+
+            std::vector<int> compression_params;
+            compression_params.push_back(cv::IMWRITE_TIFF_COMPRESSION);
+            compression_params.push_back(static_cast<int>(options.alignedImageCompression));
+
+            bool success = cv::imwrite(job->filename, saveImage, compression_params);
+            if (!success) {
+                std::cerr << "Failed to save image: " << job->filename << std::endl;
+                failedRPMs.insert(job->rpm);
+            }
+        }
+    }
+
+    ProcessingOptions options;
+    BoundedQueue<AlignedImageJob> queue;
+    std::set<int> failedRPMs;  // only touched by the worker until it is joined
+    std::thread worker;
+};
+
+// Column profiles of every replicate in one RPM group, handed from the processing stage to the writer
+struct RPMProfiles {
+    int rpm = 0;
+    std::vector<ColumnProfiles> replicates;
+    uint64_t cacheKey = 0;  // column cache key to store the profiles under, 0 = do not store
+    std::vector<std::string> alignedImages;  // aligned images queued for the group, relative to the output folder
+};
+
+// The column cache keeps the all-channel column profiles of each RPM group in a small binary file in
+// <output>/column_cache, one per group and blur setting. A rerun that only changes the channel or the
+// distance bounds finds them there and never opens the images.
+
+// Function to get the channels to reduce: all three when the group's profiles will be stored in the
+// column cache (cacheKey != 0), so any channel can be written from them later, else only the chosen ones
+int getReductionMask(const ProcessingOptions& options, uint64_t cacheKey) {
+    return cacheKey != 0 ? kAllChannelsMask : getChannelMask(options.channelChoice);
+}
+
+// Function to describe the blur settings that shape a group's profiles, e.g. "G10", or "r0" without
+// blur. With --stream-rows a blurred image is reduced like the streaming blur, so it shares its tag.
+std::string getBlurSettingTag(const ProcessingOptions& options) {
+    std::string blur = "r0";
+    if (options.blurRadius > 0) {
+        char method = options.streamRows > 0 || options.blurMethod == BlurMethod::Streaming ? 'S'
+                    : options.blurMethod == BlurMethod::Recursive ? 'F' : 'G';
+        blur = std::string(1, method) + std::to_string(options.blurRadius);
+    }
+    std::string preview = options.previewScale > 1 ? "_p" + std::to_string(options.previewScale) : "";
+    return blur + preview;
+}
+
+// Function to get the cache file of an RPM group, named after the settings that shape its profiles
+std::string getColumnCachePath(const std::string& outputFolder, const std::string& identifier, int rpm,
+                               const ProcessingOptions& options) {
+    return outputFolder + "/column_cache/" + identifier + "_" + std::to_string(rpm) + "_" +
+           getBlurSettingTag(options) + ".colsums";
+}
+
+// 64-bit FNV-1a hashing of the inputs and parameters behind cached profiles and written CSVs
+constexpr uint64_t kHashOffsetBasis = 14695981039346656037ull;
+
+// Function to mix size bytes into an FNV-1a hash
+void hashBytes(uint64_t& hash, const void* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ static_cast<const uchar*>(data)[i]) * 1099511628211ull;
+    }
+}
+
+// Function to hash what a group's profiles depend on besides the settings in the cache filename: the
+// path, size and modification time of each replicate file, in order. Returns 0 if a file cannot be
+// examined.
+uint64_t getColumnCacheKey(const std::string& folderPath, const std::vector<std::string>& filenames) {
+    uint64_t hash = kHashOffsetBasis;
+    auto mix = [&hash](const void* data, size_t size) { hashBytes(hash, data, size); };
+    for (const auto& filename : filenames) {
+        std::error_code error;
+        fs::path path = fs::absolute(fs::path(folderPath) / filename, error);
+        uint64_t size = fs::file_size(path, error);
+        if (error) {
+            return 0;
+        }
+        int64_t modified = static_cast<int64_t>(fs::last_write_time(path, error).time_since_epoch().count());
+        if (error) {
+            return 0;
+        }
+        std::string name = path.string();
+        mix(name.data(), name.size() + 1);
+        mix(&size, sizeof(size));
+        mix(&modified, sizeof(modified));
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+// Layout of a column cache file, in the byte order of the machine that wrote it: the magic "DGCOLS01",
+// the uint64 key, uint32 replicate and column counts, then for each replicate the B, G and R profiles
+// as doubles
+constexpr char kColumnCacheMagic[8] = {'D', 'G', 'C', 'O', 'L', 'S', '0', '1'};
+
+// Function to load a group's cached profiles, or return nothing if there is no entry for this key
+std::optional<RPMProfiles> loadCachedProfiles(const std::string& cachePath, uint64_t key, int rpm) {
+    std::ifstream file(cachePath, std::ios::binary);
+    char magic[8];
+    uint64_t storedKey = 0;
+    uint32_t replicates = 0, cols = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&storedKey), sizeof(storedKey));
+    file.read(reinterpret_cast<char*>(&replicates), sizeof(replicates));
+    file.read(reinterpret_cast<char*>(&cols), sizeof(cols));
+    if (!file || std::memcmp(magic, kColumnCacheMagic, sizeof(magic)) != 0 || storedKey != key || replicates != 3) {
+        return std::nullopt;
+    }
+    RPMProfiles result;
+    result.rpm = rpm;
+    result.replicates.resize(replicates);
+    for (auto& replicate : result.replicates) {
+        for (auto& profile : replicate) {
+            profile.resize(cols);
+            file.read(reinterpret_cast<char*>(profile.data()), static_cast<std::streamsize>(cols * sizeof(double)));
+        }
+    }
+    if (!file) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+// Function to store a group's all-channel profiles under its key. The file is written under a temporary
+// name and renamed, so a concurrent or interrupted run never sees half an entry.
+void storeCachedProfiles(const std::string& cachePath, const RPMProfiles& result) {
+    uint32_t replicates = static_cast<uint32_t>(result.replicates.size());
+    uint32_t cols = replicates > 0 ? static_cast<uint32_t>(result.replicates[0][0].size()) : 0;
+    for (const auto& replicate : result.replicates) {
+        for (const auto& profile : replicate) {
+            if (profile.size() != cols) {
+                return;  // not reduced for all channels
+            }
+        }
+    }
+
+    std::error_code error;
+    fs::create_directories(fs::path(cachePath).parent_path(), error);
+    std::string temporaryPath = cachePath + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(kColumnCacheMagic, sizeof(kColumnCacheMagic));
+        file.write(reinterpret_cast<const char*>(&result.cacheKey), sizeof(result.cacheKey));
+        file.write(reinterpret_cast<const char*>(&replicates), sizeof(replicates));
+        file.write(reinterpret_cast<const char*>(&cols), sizeof(cols));
+        for (const auto& replicate : result.replicates) {
+            for (const auto& profile : replicate) {
+                file.write(reinterpret_cast<const char*>(profile.data()), static_cast<std::streamsize>(cols * sizeof(double)));
+            }
+        }
+        if (!file) {
+            std::cerr << "Warning: Could not write column cache: " << cachePath << std::endl;
+            file.close();
+            fs::remove(temporaryPath, error);
+            return;
+        }
+    }
+    fs::rename(temporaryPath, cachePath, error);
+    if (error) {
+        std::cerr << "Warning: Could not write column cache: " << cachePath << std::endl;
+        fs::remove(temporaryPath, error);
+    }
+}
+
+// Subfolder of the output folder that holds preview CSVs, so the analysis scripts, which read every CSV
+// in the output folder, never mix them with the full-resolution ones
+const char* const kPreviewFolder = "preview";
+
+// Function to get the name of the CSV holding one channel of an RPM group, relative to the output folder
+std::string getProfileCSVName(const std::string& identifier, int rpm, char channel, const ProcessingOptions& options) {
+    std::string name = identifier + "_" + std::to_string(rpm) + "_" + std::string(1, channel);
+    return options.previewScale > 1 ? std::string(kPreviewFolder) + "/" + name + "ness_preview.csv" : name + "ness.csv";
+}
+
+// Function to hash the parameters that shape a CSV's contents: the distance bounds, the blur settings and
+// the number format, plus the binary formats written alongside it
+uint64_t getParameterKey(const ProcessingOptions& options) {
+    uint64_t hash = kHashOffsetBasis;
+    std::string blur = getBlurSettingTag(options);
+    hashBytes(hash, &options.distanceUpper, sizeof(options.distanceUpper));
+    hashBytes(hash, &options.distanceLower, sizeof(options.distanceLower));
+    hashBytes(hash, &options.csvPrecision, sizeof(options.csvPrecision));
+    if (options.binaryProfiles != ProfileBinaryFormat::None) {
+        hashBytes(hash, &options.binaryProfiles, sizeof(options.binaryProfiles));  // keeps CSV-only keys as they were
+    }
+    hashBytes(hash, blur.data(), blur.size());
+    return hash;
+}
+
+// Function to check whether aligned images are saved: they show whole blurred images, which
+// --stream-rows and the streaming blur never hold
+bool savesAlignedImages(const ProcessingOptions& options) {
+    return options.alignedImageFormat != AlignedImageFormat::None && options.streamRows == 0 &&
+           !(options.blurMethod == BlurMethod::Streaming && options.blurRadius > 0);
+}
+
+// Function to hash the settings that shape an aligned image: its format, compression and width, and
+// the blur settings of the image it shows
+uint64_t getAlignedImageKey(const ProcessingOptions& options) {
+    uint64_t hash = kHashOffsetBasis;
+    std::string blur = getBlurSettingTag(options);
+    hashBytes(hash, &options.alignedImageFormat, sizeof(options.alignedImageFormat));
+    hashBytes(hash, &options.alignedImageCompression, sizeof(options.alignedImageCompression));
+    hashBytes(hash, &options.alignedImageWidth, sizeof(options.alignedImageWidth));
+    hashBytes(hash, blur.data(), blur.size());
+    return hash;
+}
+
+// Function to get the start of the names of an RPM group's aligned images relative to the output folder,
+// "aligned_images/<ID>_<RPM>_R"; the replicate number and the image size follow
+std::string getAlignedImagePrefix(const std::string& identifier, int rpm) {
+    return "aligned_images/" + identifier + "_" + std::to_string(rpm) + "_R";
+}
+
+// Build manifest of a dataset: for each CSV and aligned image written, the keys of the replicate files
+// and of the parameters it was made from, kept in <output>/<identifier>_manifest.txt as lines of
+// "<output name> <inputs key> <parameters key>" (keys in hex). An output whose keys still match is up to date.
+struct ManifestEntry {
+    uint64_t inputKey = 0;
+    uint64_t parameterKey = 0;
+};
+using BuildManifest = std::map<std::string, ManifestEntry>;
+
+// Function to get the build manifest path of a dataset
+std::string getManifestPath(const std::string& outputFolder, const std::string& identifier) {
+    return outputFolder + "/" + identifier + "_manifest.txt";
+}
+
+// Function to read a build manifest; a missing or unreadable one is empty, so everything is rebuilt
+BuildManifest loadBuildManifest(const std::string& manifestPath) {
+    BuildManifest manifest;
+    std::ifstream file(manifestPath);
+    std::string name;
+    ManifestEntry entry;
+    while (file >> name >> std::hex >> entry.inputKey >> entry.parameterKey) {
+        manifest[name] = entry;
+    }
+    return manifest;
+}
+
+// Function to write a build manifest under a temporary name and rename it into place
+void saveBuildManifest(const std::string& manifestPath, const BuildManifest& manifest) {
+    std::string temporaryPath = manifestPath + ".tmp";
+    std::error_code error;
+    {
+        std::ofstream file(temporaryPath, std::ios::trunc);
+        file << std::hex;
+        for (const auto& [name, entry] : manifest) {
+            file << name << " " << entry.inputKey << " " << entry.parameterKey << "\n";
+        }
+        if (!file) {
+            std::cerr << "Warning: Could not write build manifest: " << manifestPath << std::endl;
+            file.close();
+            fs::remove(temporaryPath, error);
+            return;
+        }
+    }
+    fs::rename(temporaryPath, manifestPath, error);
+    if (error) {
+        std::cerr << "Warning: Could not write build manifest: " << manifestPath << std::endl;
+        fs::remove(temporaryPath, error);
+    }
+}
+
+// Function to check whether every requested CSV of an RPM group, and each of its aligned images when
+// they are saved, exists and was made from the same inputs and parameters
+bool isRPMGroupUpToDate(const BuildManifest& manifest, const std::string& outputFolder, const std::string& identifier,
+                        int rpm, uint64_t inputKey, uint64_t parameterKey, const ProcessingOptions& options) {
+    int channelMask = getChannelMask(options.channelChoice);
+    for (char channel : {'R', 'G', 'B'}) {
+        if (!((channelMask >> getChannelIndex(channel)) & 1)) {
+            continue;
+        }
+        std::string name = getProfileCSVName(identifier, rpm, channel, options);
+        auto it = manifest.find(name);
+        std::error_code error;
+        if (inputKey == 0 || it == manifest.end() || it->second.inputKey != inputKey ||
+            it->second.parameterKey != parameterKey || !fs::exists(outputFolder + "/" + name, error)) {
+            return false;
+        }
+    }
+    if (!savesAlignedImages(options)) {
+        return true;
+    }
+
+    // The aligned images are named after their size, so look them up by the group's prefix
+    uint64_t alignedKey = getAlignedImageKey(options);
+    std::string prefix = getAlignedImagePrefix(identifier, rpm);
+    int alignedImages = 0;
+    for (auto it = manifest.lower_bound(prefix); it != manifest.end() && it->first.starts_with(prefix); ++it) {
+        std::error_code error;
+        if (it->second.inputKey != inputKey || it->second.parameterKey != alignedKey ||
+            !fs::exists(outputFolder + "/" + it->first, error)) {
+            return false;
+        }
+        ++alignedImages;
+    }
+    return alignedImages == 3;
+}
+
+// Sequential reader of an image's rows, converted to 3-channel BGR at the file's depth (as cv::imread
+// with IMREAD_ANYDEPTH | IMREAD_COLOR), so images larger than memory can be reduced a few rows at a time.
+// Opening reads only the header; rows, cols and depth describe the full image.
+class RowImageReader {
+public:
+    virtual ~RowImageReader() = default;
+
+    // Function to decode the next count rows into rows 0 .. count - 1 of buffer (count x cols, CV_MAKETYPE(depth, 3))
+    virtual bool readRows(cv::Mat& buffer, int count) = 0;
+
+    int rows = 0;
+    int cols = 0;
+    int depth = CV_8U;
+};
+
+// Function to convert one decoded row of 1 (gray), 2 (gray + alpha), 3 (RGB) or 4 (RGBA) samples per pixel to BGR
+template <typename T>
+void convertRowToBGR(const T* in, int samples, int cols, T* out) {
+    for (int x = 0; x < cols; ++x) {
+        const T* pixel = in + static_cast<size_t>(x) * samples;
+        if (samples < 3) {
+            out[3 * x] = out[3 * x + 1] = out[3 * x + 2] = pixel[0];
+        } else {
+            out[3 * x] = pixel[2];
+            out[3 * x + 1] = pixel[1];
+            out[3 * x + 2] = pixel[0];
+        }
+    }
+}
+
+// Fallback for formats and layouts the row readers do not handle (tiled or planar TIFFs, interlaced
+// PNGs, other formats): decodes the whole image up front, so memory is not bounded
+class WholeImageRowReader : public RowImageReader {
+public:
+    explicit WholeImageRowReader(cv::Mat decoded, std::shared_ptr<const MappedFile> mappedFile = nullptr)
+        : image(std::move(decoded)), mapping(std::move(mappedFile)) {
+        rows = image.rows;
+        cols = image.cols;
+        depth = image.depth();
+    }
+
+    bool readRows(cv::Mat& buffer, int count) override {
+        if (nextRow + count > rows) {
+            return false;
+        }
+        cv::Mat target = buffer.rowRange(0, count);
+        image.rowRange(nextRow, nextRow + count).copyTo(target);
+        nextRow += count;
+        return true;
+    }
+
+private:
+    cv::Mat image;
+    std::shared_ptr<const MappedFile> mapping;  // set when image points into a mapped .dgraw file
+    int nextRow = 0;
+};
+
+#ifdef DYEGRADIENT_HAVE_TIFF
+// Row reader for stripped, contiguous TIFFs of 8/16-bit integer or 32-bit float samples; libtiff
+// decodes one strip at a time behind TIFFReadScanline
+class TiffRowReader : public RowImageReader {
+public:
+    ~TiffRowReader() override {
+        if (tiff) {
+            TIFFClose(tiff);
+        }
+    }
+
+    static std::unique_ptr<RowImageReader> open(const std::string& path) {
+        auto reader = std::make_unique<TiffRowReader>();
+        reader->tiff = TIFFOpen(path.c_str(), "r");
+        if (!reader->tiff || !reader->readHeader()) {
+            return nullptr;
+        }
+        return reader;
+    }
+
+    bool readRows(cv::Mat& buffer, int count) override {
+        for (int i = 0; i < count; ++i, ++nextRow) {
+            if (TIFFReadScanline(tiff, scanline.data(), static_cast<uint32_t>(nextRow), 0) < 0) {
+                return false;
+            }
+            switch (depth) {
+                case CV_8U:
+                    convertRowToBGR(scanline.data(), samples, cols, buffer.ptr<uchar>(i));
+                    break;
+                case CV_16U:
+                    convertRowToBGR(reinterpret_cast<const ushort*>(scanline.data()), samples, cols, buffer.ptr<ushort>(i));
+                    break;
+                default:
+                    convertRowToBGR(reinterpret_cast<const float*>(scanline.data()), samples, cols, buffer.ptr<float>(i));
+                    break;
+            }
+        }
+        return true;
+    }
+
+private:
+    bool readHeader() {
+        uint32_t width = 0, height = 0;
+        uint16_t bits = 8, sampleCount = 1, format = SAMPLEFORMAT_UINT, planar = PLANARCONFIG_CONTIG;
+        uint16_t photometric = PHOTOMETRIC_MINISBLACK;
+        TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &width);
+        TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &height);
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_BITSPERSAMPLE, &bits);
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLESPERPIXEL, &sampleCount);
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLEFORMAT, &format);
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_PLANARCONFIG, &planar);
+        TIFFGetField(tiff, TIFFTAG_PHOTOMETRIC, &photometric);
+
+        if (bits == 8 && format == SAMPLEFORMAT_UINT) {
+            depth = CV_8U;
+        } else if (bits == 16 && format == SAMPLEFORMAT_UINT) {
+            depth = CV_16U;
+        } else if (bits == 32 && format == SAMPLEFORMAT_IEEEFP) {
+            depth = CV_32F;
+        } else {
+            return false;
+        }
+        bool gray = photometric == PHOTOMETRIC_MINISBLACK && sampleCount <= 2;
+        bool rgb = photometric == PHOTOMETRIC_RGB && sampleCount >= 3 && sampleCount <= 4;
+        if (TIFFIsTiled(tiff) || planar != PLANARCONFIG_CONTIG || !(gray || rgb) || width == 0 || height == 0) {
+            return false;
+        }
+
+        rows = static_cast<int>(height);
+        cols = static_cast<int>(width);
+        samples = sampleCount;
+        scanline.resize(static_cast<size_t>(TIFFScanlineSize(tiff)));
+        return true;
+    }
+
+    TIFF* tiff = nullptr;
+    int samples = 1;
+    int nextRow = 0;
+    std::vector<uchar> scanline;
+};
+#endif
+
+#ifdef DYEGRADIENT_HAVE_PNG
+// Row reader for non-interlaced PNGs; libpng expands palette and gray images, drops alpha and
+// delivers BGR rows in native byte order directly
+class PngRowReader : public RowImageReader {
+public:
+    ~PngRowReader() override {
+        if (png) {
+            png_destroy_read_struct(&png, &info, nullptr);
+        }
+        if (file) {
+            std::fclose(file);
+        }
+    }
+
+    static std::unique_ptr<RowImageReader> open(const std::string& path) {
+        auto reader = std::make_unique<PngRowReader>();
+        reader->file = std::fopen(path.c_str(), "rb");
+        if (!reader->file) {
+            return nullptr;
+        }
+        reader->png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+        reader->info = reader->png ? png_create_info_struct(reader->png) : nullptr;
+        if (!reader->info || !reader->readHeader()) {
+            return nullptr;
+        }
+        return reader;
+    }
+
+    // libpng reports errors by longjmp, so nothing with a destructor may live in this frame
+    bool readRows(cv::Mat& buffer, int count) override {
+        if (setjmp(png_jmpbuf(png))) {
+            return false;
+        }
+        for (int i = 0; i < count; ++i) {
+            png_read_row(png, buffer.ptr<png_byte>(i), nullptr);
+        }
+        return true;
+    }
+
+private:
+    bool readHeader() {
+        if (setjmp(png_jmpbuf(png))) {
+            return false;
+        }
+        png_init_io(png, file);
+        png_read_info(png, info);
+        if (png_get_interlace_type(png, info) != PNG_INTERLACE_NONE) {
+            return false;
+        }
+
+        int colorType = png_get_color_type(png, info);
+        int bitDepth = png_get_bit_depth(png, info);
+        if (colorType == PNG_COLOR_TYPE_PALETTE) {
+            png_set_palette_to_rgb(png);
+        }
+        if (colorType == PNG_COLOR_TYPE_GRAY && bitDepth < 8) {
+            png_set_expand_gray_1_2_4_to_8(png);
+        }
+        if (colorType == PNG_COLOR_TYPE_GRAY || colorType == PNG_COLOR_TYPE_GRAY_ALPHA) {
+            png_set_gray_to_rgb(png);
+        }
+        png_set_strip_alpha(png);
+        png_set_bgr(png);
+        if (bitDepth == 16 && std::endian::native == std::endian::little) {
+            png_set_swap(png);
+        }
+        png_read_update_info(png, info);
+
+        rows = static_cast<int>(png_get_image_height(png, info));
+        cols = static_cast<int>(png_get_image_width(png, info));
+        depth = bitDepth == 16 ? CV_16U : CV_8U;
+        return png_get_channels(png, info) == 3;
+    }
+
+    FILE* file = nullptr;
+    png_structp png = nullptr;
+    png_infop info = nullptr;
+};
+#endif
+
+#ifdef DYEGRADIENT_HAVE_JPEG
+// Row reader for JPEGs; libjpeg decodes scanline by scanline (progressive files are buffered by the
+// library as coefficients)
+class JpegRowReader : public RowImageReader {
+public:
+    ~JpegRowReader() override {
+        if (created) {
+            jpeg_destroy_decompress(&decoder);
+        }
+        if (file) {
+            std::fclose(file);
+        }
+    }
+
+    static std::unique_ptr<RowImageReader> open(const std::string& path) {
+        auto reader = std::make_unique<JpegRowReader>();
+        reader->file = std::fopen(path.c_str(), "rb");
+        if (!reader->file || !reader->readHeader()) {
+            return nullptr;
+        }
+        reader->scanline.resize(static_cast<size_t>(reader->cols) * reader->samples);
+        return reader;
+    }
+
+    // libjpeg reports errors by longjmp, so nothing with a destructor may live in this frame
+    bool readRows(cv::Mat& buffer, int count) override {
+        if (setjmp(errors.jump)) {
+            return false;
+        }
+        JSAMPROW row = scanline.data();
+        for (int i = 0; i < count; ++i) {
+            if (jpeg_read_scanlines(&decoder, &row, 1) != 1) {
+                return false;
+            }
+            convertRowToBGR(scanline.data(), samples, cols, buffer.ptr<uchar>(i));
+        }
+        return true;
+    }
+
+private:
+    struct ErrorManager {
+        jpeg_error_mgr base;
+        std::jmp_buf jump;
+    };
+
+    static void errorExit(j_common_ptr info) {
+        (*info->err->output_message)(info);
+        std::longjmp(reinterpret_cast<ErrorManager*>(info->err)->jump, 1);
+    }
+
+    bool readHeader() {
+        decoder.err = jpeg_std_error(&errors.base);
+        errors.base.error_exit = errorExit;
+        if (setjmp(errors.jump)) {
+            return false;
+        }
+        jpeg_create_decompress(&decoder);
+        created = true;
+        jpeg_stdio_src(&decoder, file);
+        jpeg_save_markers(&decoder, JPEG_APP0 + 1, 0xFFFF);
+        jpeg_read_header(&decoder, TRUE);
+        // cv::imread rotates and flips by the EXIF orientation; leave such images to the whole-image path
+        // so that the same columns are reduced
+        int orientation = getExifOrientation();
+        if (orientation >= 2 && orientation <= 8) {
+            return false;
+        }
+        if (decoder.jpeg_color_space == JCS_GRAYSCALE) {
+            decoder.out_color_space = JCS_GRAYSCALE;
+        } else if (decoder.jpeg_color_space == JCS_YCbCr || decoder.jpeg_color_space == JCS_RGB) {
+            decoder.out_color_space = JCS_RGB;
+        } else {
+            return false;
+        }
+        jpeg_start_decompress(&decoder);
+
+        rows = static_cast<int>(decoder.output_height);
+        cols = static_cast<int>(decoder.output_width);
+        samples = decoder.output_components;
+        depth = CV_8U;
+        return true;
+    }
+
+    // Function to get the Orientation tag of IFD0 in the EXIF (APP1) marker, or 1 (upright) if there is none
+    int getExifOrientation() const {
+        for (jpeg_saved_marker_ptr marker = decoder.marker_list; marker; marker = marker->next) {
+            const JOCTET* data = marker->data;
+            size_t size = marker->data_length;
+            if (marker->marker != JPEG_APP0 + 1 || size < 14 || std::memcmp(data, "Exif\0\0", 6) != 0) {
+                continue;
+            }
+            const JOCTET* tiff = data + 6;
+            size_t tiffSize = size - 6;
+            bool bigEndian = tiff[0] == 'M';
+            auto read16 = [&](size_t offset) {
+                return bigEndian ? (tiff[offset] << 8) | tiff[offset + 1] : tiff[offset] | (tiff[offset + 1] << 8);
+            };
+            auto read32 = [&](size_t offset) {
+                return bigEndian ? (uint32_t(read16(offset)) << 16) | uint32_t(read16(offset + 2))
+                                 : uint32_t(read16(offset)) | (uint32_t(read16(offset + 2)) << 16);
+            };
+            size_t ifd = read32(4);
+            if (ifd + 2 > tiffSize) {
+                return 1;
+            }
+            int entries = read16(ifd);
+            for (int i = 0; i < entries && ifd + 2 + 12 * (i + 1) <= tiffSize; ++i) {
+                size_t entry = ifd + 2 + 12 * static_cast<size_t>(i);
+                if (read16(entry) == 0x0112) {
+                    return read16(entry + 8);
+                }
+            }
+            return 1;
+        }
+        return 1;
+    }
+
+    FILE* file = nullptr;
+    jpeg_decompress_struct decoder{};
+    ErrorManager errors{};
+    bool created = false;
+    int samples = 3;
+    std::vector<JSAMPLE> scanline;
+};
+#endif
+
+// Function to open an image for row streaming, choosing the reader by extension and falling back to
+// decoding the whole image. Returns nullptr if the image cannot be read at all.
+std::unique_ptr<RowImageReader> openRowImageReader(const std::string& path) {
+    std::string extension = getLowerCaseExtension(path);
+    std::unique_ptr<RowImageReader> reader;
+#ifdef DYEGRADIENT_HAVE_TIFF
+    if (extension == ".tif" || extension == ".tiff") {
+        reader = TiffRowReader::open(path);
+    }
+#endif
+#ifdef DYEGRADIENT_HAVE_PNG
+    if (extension == ".png") {
+        reader = PngRowReader::open(path);
+    }
+#endif
+#ifdef DYEGRADIENT_HAVE_JPEG
+    if (extension == ".jpg" || extension == ".jpeg") {
+        reader = JpegRowReader::open(path);
+    }
+#endif
+    if (reader) {
+        return reader;
+    }
+
+    if (logEnabled(LogLevel::Debug)) {
+        std::cout << "No row decoder for " << path << ", decoding the whole image" << std::endl;
+    }
+    if (extension == ".dgraw") {
+        // Mapped rather than decoded, so its rows are paged in as they are read
+        DecodedImage mapped = mapImageFile(path, path);
+        return mapped.image.empty() ? nullptr : std::make_unique<WholeImageRowReader>(mapped.image, mapped.mapping);
+    }
+    cv::Mat image = cv::imread(path, cv::IMREAD_ANYDEPTH | cv::IMREAD_COLOR);
+    if (image.empty()) {
+        return nullptr;
+    }
+    return std::make_unique<WholeImageRowReader>(image);
+}
+
+// Function to reduce the top-left rows x cols region of an image read row by row to its average
+// chromaticity per column, blurred with the exact Gaussian first when blurRadius > 0. At most chunkRows
+// decoded rows (rounded up to whole reduction bands) are held at a time, plus one kernel height of
+// filtered rows when blurring. The band layout and summation order are those of computeColumnProfiles
+// and computeBlurredColumnProfiles, so the profiles match the whole-image results bit for bit (the
+// streaming blur's, for a blurred image).
+std::optional<ColumnProfiles> streamColumnProfiles(RowImageReader& reader, int rows, int cols, int blurRadius,
+                                                   int channelMask, int chunkRows, TraceScope& trace) {
+    static const SimdLevel simdLevel = detectSimdLevel();
+    ChromaticityRowKernel accumulateRow = selectChromaticityRowKernel(simdLevel, channelMask);
+    chunkRows = (std::max(1, chunkRows) + kReductionBandRows - 1) / kReductionBandRows * kReductionBandRows;
+    cv::Mat buffer = pooledMat();
+    buffer.create(chunkRows, reader.cols, CV_MAKETYPE(reader.depth, 3));
+    ColumnProfiles totals;
+
+    // Function to decode the next count rows of the image into the buffer
+    auto readChunk = [&](int count) {
+        StageTimer timer(Stage::Decode);
+        timer.trace.rpm = trace.rpm;
+        timer.trace.replicate = trace.replicate;
+        timer.trace.label = trace.label;
+        timer.addImage(buffer.rowRange(0, count));
+        return reader.readRows(buffer, count);
+    };
+
+    if (blurRadius <= 0) {
+        ChromaticityRowsReducer reduceRows = selectChromaticityRowsReducer(reader.depth);
+        for (int chunkBegin = 0; chunkBegin < rows; chunkBegin += chunkRows) {
+            int count = std::min(chunkRows, rows - chunkBegin);
+            if (!readChunk(count)) {
+                return std::nullopt;
+            }
+
+            StageTimer timer(Stage::Reduce);
+            cv::Mat chunk = buffer(cv::Rect(0, 0, cols, count));
+            timer.addImage(chunk);
+            int bandCount = (count + kReductionBandRows - 1) / kReductionBandRows;
+            std::vector<ColumnProfiles> bandSums(bandCount);
+            cv::parallel_for_(cv::Range(0, bandCount), [&](const cv::Range& range) {
+                for (int band = range.start; band < range.end; ++band) {
+                    ChannelSums sums = allocateBandSums(bandSums[band], channelMask, cols);
+                    int rowEnd = std::min(count, (band + 1) * kReductionBandRows);
+                    reduceRows(chunk, band * kReductionBandRows, rowEnd, accumulateRow, sums);
+                }
+            });
+            for (const auto& band : bandSums) {
+                addBandSums(totals, band, channelMask, cols);
+            }
+        }
+        finishColumnAverages(totals, channelMask, cols, rows);
+        return totals;
+    }
+
+    HorizontalGaussianRowFilter filterRow = selectHorizontalGaussianRowFilter(reader.depth);
+    std::vector<float> kernel = getGaussianKernelWeights(blurRadius);
+    int kernelSize = static_cast<int>(kernel.size());
+    int bandRows = getBlurredBandRows(kernelSize);
+    std::vector<float> window(static_cast<size_t>(kernelSize) * 3 * cols);
+    std::vector<float> padded(3 * (cols + 2 * blurRadius));
+    std::vector<float> blurred(3 * cols);
+    ColumnProfiles band;
+    ChannelSums sums;
+
+    // Source rows needed: everything up to the last output row's lower kernel edge
+    int sourceRows = std::min(reader.rows, rows + blurRadius);
+    int y = 0;
+    for (int chunkBegin = 0; chunkBegin < sourceRows; chunkBegin += chunkRows) {
+        int count = std::min(chunkRows, sourceRows - chunkBegin);
+        if (!readChunk(count)) {
+            return std::nullopt;
+        }
+
+        StageTimer timer(Stage::Reduce);
+        timer.addImage(buffer.rowRange(0, count));
+        for (int sourceRow = chunkBegin; sourceRow < chunkBegin + count; ++sourceRow) {
+            filterRow(buffer, sourceRow - chunkBegin, cols, kernel, padded.data(),
+                      window.data() + static_cast<size_t>(sourceRow % kernelSize) * 3 * cols);
+
+            // Emit every output row whose kernel now lies entirely in the window
+            for (; y < rows && std::min(reader.rows - 1, y + blurRadius) <= sourceRow; ++y) {
+                if (y % bandRows == 0) {
+                    if (y > 0) {
+                        addBandSums(totals, band, channelMask, cols);
+                    }
+                    sums = allocateBandSums(band, channelMask, cols);
+                }
+                verticalGaussianRow(window, y, reader.rows, cols, kernel, blurred.data());
+                accumulateRow(blurred.data(), cols, sums);
+            }
+        }
+    }
+    addBandSums(totals, band, channelMask, cols);
+    finishColumnAverages(totals, channelMask, cols, rows);
+    return totals;
+}
+
+// Function to open the replicates of one RPM group for row streaming and queue their reductions on
+// the pool. The region reduced is the common top-left area alignImageWidths/alignImageHeights keep,
+// found from the headers alone. Returns fewer futures than filenames if an image cannot be opened.
+std::vector<std::future<std::optional<ColumnProfiles>>> submitStreamedReductions(
+        const std::vector<std::string>& filenames, const std::string& folderPath, int rpm,
+        const ProcessingOptions& options, int channelMask, ThreadPool& pool) {
+    std::vector<std::shared_ptr<RowImageReader>> readers;
+    int rows = std::numeric_limits<int>::max();
+    int cols = std::numeric_limits<int>::max();
+    for (const auto& filename : filenames) {
+        std::shared_ptr<RowImageReader> reader = openRowImageReader(folderPath + "/" + filename);
+        if (!reader) {
+            std::cerr << "Error: Could not load image: " << filename << std::endl;
+            return {};
+        }
+        rows = std::min(rows, reader->rows);
+        cols = std::min(cols, reader->cols);
+        readers.push_back(std::move(reader));
+    }
+
+    std::vector<std::future<std::optional<ColumnProfiles>>> profiles;
+    for (size_t i = 0; i < readers.size(); ++i) {
+        profiles.push_back(pool.submit([reader = readers[i], filename = filenames[i], rpm, replicate = static_cast<int>(i) + 1,
+                                        rows, cols, channelMask, blurRadius = options.blurRadius, chunkRows = options.streamRows] {
+            TraceScope trace("Stream replicate");
+            trace.rpm = rpm;
+            trace.replicate = replicate;
+            trace.label = &filename;
+            std::optional<ColumnProfiles> result =
+                streamColumnProfiles(*reader, rows, cols, blurRadius, channelMask, chunkRows, trace);
+            if (!result) {
+                std::cerr << "Error: Could not decode image: " << filename << std::endl;
+            }
+            return result;
+        }));
+    }
+    return profiles;
+}
+
+// Function to gather the streamed replicate profiles of one RPM group for the CSV writer
+std::optional<RPMProfiles> collectStreamedProfiles(std::vector<std::future<std::optional<ColumnProfiles>>>& pending,
+                                                   int rpm) {
+    if (logEnabled(LogLevel::Info)) {
+        std::cout << "Processing RPM: " << rpm << std::endl;
+    }
+    RPMProfiles result;
+    result.rpm = rpm;
+    bool complete = true;
+    for (auto& replicate : pending) {
+        std::optional<ColumnProfiles> profiles = replicate.get();
+        complete = complete && profiles.has_value();
+        if (profiles) {
+            result.replicates.push_back(std::move(*profiles));
+        }
+    }
+    if (!complete || result.replicates.size() != 3) {
+        std::cerr << "Error: Unexpected number of images for RPM " << rpm << ". Expected 3, but found "
+                  << result.replicates.size() << "." << std::endl;
+        return std::nullopt;
+    }
+    return result;
+}
+
+// Function to process images for a specific RPM: blur, align and reduce them to column profiles.
+// With an alignedWriter the aligned images are also queued for writing as verification TIFFs.
+std::optional<RPMProfiles> processRPMImages(const std::vector<DecodedImage>& decodedImages,
+                     int rpm, const std::string& outputFolder, const std::string& identifier,
+                     const ProcessingOptions& options, int channelMask, AlignedImageWriter* alignedWriter) {
+    std::vector<cv::Mat> images;
+    std::vector<std::string> replicateNames;
+    std::vector<int> sourceDepths;
+    std::vector<bool> rgbOrders;
+    std::vector<std::shared_ptr<const MappedFile>> mappings;
+    bool streamBlur = options.blurMethod == BlurMethod::Streaming && options.blurRadius > 0;
+    TraceScope trace("Process RPM");
+    trace.rpm = rpm;
+
+    if (logEnabled(LogLevel::Info)) {
+        std::cout << "Processing RPM: " << rpm << std::endl;
+    }
+
+    // Take the decoded images and apply the blur if requested
+    for (const auto& decoded : decodedImages) {
+        if (decoded.image.empty()) {
+            continue;
+        }
+        cv::Mat image = decoded.image;
+        bool rgbOrder = decoded.rgbOrder;
+        if (logEnabled(LogLevel::Debug)) {
+            std::cout << "Original image dimensions: " << image.rows << "x" << image.cols << std::endl;
+        }
+
+        // Apply the blur only if radius > 0
+        if (options.blurRadius > 0 && !streamBlur) {
+            StageTimer timer(Stage::Blur);
+            timer.trace.rpm = rpm;
+            timer.trace.replicate = static_cast<int>(images.size()) + 1;
+            timer.trace.label = &decoded.filename;
+            timer.addImage(image);
+            applyBlur(image, options);
+            if (rgbOrder) {
+                // The blur wrote a new image anyway; restore BGR so that float chromaticities sum as usual
+                cv::cvtColor(image, image, cv::COLOR_RGB2BGR);
+                rgbOrder = false;
+            }
+        }
+        images.push_back(image);
+        replicateNames.push_back(decoded.filename);
+        sourceDepths.push_back(decoded.image.depth());
+        rgbOrders.push_back(rgbOrder);
+        mappings.push_back(decoded.mapping);
+    }
+
+    // Check if we have the expected number of replicates
+    if (images.size() != 3) {
+        std::cerr << "Error: Unexpected number of images for RPM " << rpm << ". Expected 3, but found " << images.size() << "." << std::endl;
+        return std::nullopt;
+    }
+
+    // Align image widths and heights, keeping the full frames as blur context for the streaming engine
+    std::vector<cv::Mat> sourceImages = images;
+    {
+        StageTimer timer(Stage::Align);
+        timer.trace.rpm = rpm;
+        alignImageWidths(images);
+        alignImageHeights(images);
+        for (const auto& image : images) {
+            timer.addImage(image);
+        }
+    }
+    // Debug original image info; the min/max is a full extra pass, so only compute it when shown
+    for (size_t i = 0; i < images.size() && logEnabled(LogLevel::Debug); ++i) {
+        double minVal, maxVal;
+        cv::minMaxLoc(images[i].reshape(1), &minVal, &maxVal);
+        std::cout << "Original image type: " << images[i].type()
+                  << ", channels: " << images[i].channels()
+                  << ", min/max values: " << minVal << "/" << maxVal << std::endl;
+    }
+
+    // Queue aligned and blurred images for verification, if requested
+    std::string alignedImagesPath = outputFolder + "/aligned_images";
+    if (alignedWriter) {
+        std::filesystem::create_directories(alignedImagesPath);
+    }
+    
+    std::vector<std::string> alignedImageNames;
+    for (size_t i = 0; i < images.size() && alignedWriter; ++i) {
+        // Ensure proper path separators and file extension
+        std::string alignedImageName = getAlignedImagePrefix(identifier, rpm) + std::to_string(i + 1) + 
+            "_" + std::to_string(images[i].cols) + "x" + std::to_string(images[i].rows) + 
+            "_aligned.tif";  // Changed to .tif
+        std::string outputFilename = outputFolder + "/" + alignedImageName;
+            
+        // Replace any potential Windows backslashes with forward slashes
+        std::replace(outputFilename.begin(), outputFilename.end(), '\\', '/');
+
+        alignedWriter->write({outputFilename, images[i], sourceDepths[i], rgbOrders[i], mappings[i], rpm});
+        alignedImageNames.push_back(alignedImageName);
+    }
+
+    // Debug aligned image dimensions
+    for (size_t i = 0; i < images.size() && logEnabled(LogLevel::Debug); ++i) {
+        std::cout << "Aligned image " << (i + 1) << " dimensions: "
+                  << images[i].rows << "x" << images[i].cols << std::endl;
+    }
+
+    // Reduce each replicate to its column profiles in one pass, then hand them to the CSV writer
+    RPMProfiles result;
+    result.rpm = rpm;
+    result.alignedImages = std::move(alignedImageNames);
+    for (size_t i = 0; i < images.size(); ++i) {
+        StageTimer timer(Stage::Reduce);
+        timer.trace.rpm = rpm;
+        timer.trace.replicate = static_cast<int>(i) + 1;
+        timer.addImage(images[i]);
+        if (streamBlur) {
+            result.replicates.push_back(computeBlurredColumnProfiles(sourceImages[i], images[i].rows, images[i].cols,
+                                                                     options.blurRadius, channelMask, rgbOrders[i]));
+        } else {
+            result.replicates.push_back(computeColumnProfiles(images[i], channelMask, rgbOrders[i]));
+        }
+    }
+    return result;
+}
+
+// Function to write one CSV per requested channel of an RPM group, in R, G, B order
+bool writeRPMProfiles(RPMProfiles& result, const std::string& outputFolder, const std::string& identifier,
+                      const ProcessingOptions& options) {
+    TraceScope trace("Write RPM");
+    trace.rpm = result.rpm;
+    int channelMask = getChannelMask(options.channelChoice);
+    for (char channel : {'R', 'G', 'B'}) {
+        int channelIndex = getChannelIndex(channel);
+        if (!((channelMask >> channelIndex) & 1)) {
+            continue;
+        }
+        std::vector<std::vector<double>> profiles;
+        for (auto& replicate : result.replicates) {
+            profiles.push_back(std::move(replicate[channelIndex]));
+        }
+
+        std::string csvFilePath = outputFolder + "/" + getProfileCSVName(identifier, result.rpm, channel, options);
+        bool preview = options.previewScale > 1;
+        if (!writeProfileCSV(csvFilePath, channel, options.distanceUpper, options.distanceLower, profiles, options.csvPrecision)) {
+            return false;
+        }
+        if (logEnabled(LogLevel::Info)) {
+            std::cout << "Processed RPM " << result.rpm << " and saved " << getChannelName(channel)
+                      << " data to: " << csvFilePath << std::endl;
+        }
+
+        // The same table as .npy and/or .mat, named like the CSV. Copies this run does not write are removed,
+        // as they were made with other parameters and would no longer match the CSV.
+        std::string basePath = csvFilePath.substr(0, csvFilePath.size() - 4);  // without ".csv"
+        bool npy = options.binaryProfiles == ProfileBinaryFormat::Npy || options.binaryProfiles == ProfileBinaryFormat::Both;
+        bool mat = options.binaryProfiles == ProfileBinaryFormat::Mat || options.binaryProfiles == ProfileBinaryFormat::Both;
+        if (npy || mat) {
+            std::vector<double> table = buildProfileTable(options.distanceUpper, options.distanceLower, profiles);
+            if ((npy && !writeProfileNpy(basePath + ".npy", table, profiles[0].size(), profiles.size() + 2)) ||
+                (mat && !writeProfileMat(basePath + ".mat", table, profiles[0].size(), profiles.size()))) {
+                return false;
+            }
+        }
+        std::error_code error;
+        if (!npy) {
+            fs::remove(basePath + ".npy", error);
+        }
+        if (!mat) {
+            fs::remove(basePath + ".mat", error);
+        }
+
+        // Report the preview's error against the full-resolution profile, if a full run has written one
+        if (preview && logEnabled(LogLevel::Info)) {
+            ProcessingOptions fullOptions = options;
+            fullOptions.previewScale = 1;
+            std::vector<double> fullAverage =
+                readProfileCSVAverages(outputFolder + "/" + getProfileCSVName(identifier, result.rpm, channel, fullOptions));
+            if (fullAverage.size() < profiles[0].size()) {
+                std::cout << "No full-resolution " << getChannelName(channel) << " CSV for RPM " << result.rpm
+                          << " to compare the preview with" << std::endl;
+            } else {
+                std::vector<double> previewAverage(profiles[0].size(), 0.0);
+                for (const auto& profile : profiles) {
+                    for (size_t x = 0; x < profile.size(); ++x) {
+                        previewAverage[x] += profile[x] / profiles.size();
+                    }
+                }
+                double maxError, meanError;
+                comparePreviewProfile(previewAverage, fullAverage, maxError, meanError);
+                std::cout << "Preview (1/" << options.previewScale << ") vs full-resolution " << getChannelName(channel)
+                          << " for RPM " << result.rpm << ": max error " << maxError << ", mean error " << meanError << std::endl;
+            }
+        }
+    }
+    return true;
+}
+
+// Function to run all RPM groups through a three-stage pipeline: decode (on decodePool) -> blur and
+// reduce (one thread, itself parallel over row bands) -> CSV write (one thread). Stages are joined by
+// queues holding at most queueDepth groups, so group N+1 decodes while group N is reduced and group
+// N-1 is written, and a slow stage holds back the ones before it instead of letting memory grow.
+// Returns the RPMs whose CSVs (and aligned images) were all written, each with the names of its aligned
+// images relative to the output folder.
+std::map<int, std::vector<std::string>> runRPMPipeline(const FilenameIndex& index, const std::vector<int>& uniqueRPMs,
+                                const std::string& folderPath, const std::string& outputFolder, const std::string& identifier,
+                                const ProcessingOptions& options, ThreadPool& decodePool, int queueDepth) {
+    struct PendingGroup {
+        int rpm;
+        std::vector<std::future<DecodedImage>> images;
+        std::vector<std::future<std::optional<ColumnProfiles>>> streamedProfiles;  // with --stream-rows
+        std::optional<RPMProfiles> cached;  // found in the column cache, so nothing is decoded
+        uint64_t cacheKey = 0;
+    };
+    BoundedQueue<PendingGroup> decodeQueue(queueDepth);
+    BoundedQueue<RPMProfiles> writeQueue(queueDepth);
+
+    // Aligned verification images go to their own writer thread; the streaming blur never stores them
+    std::optional<AlignedImageWriter> alignedWriter;
+    bool streamRows = options.streamRows > 0;
+    if (streamRows && options.blurMethod == BlurMethod::Recursive && options.blurRadius > 0 && logEnabled(LogLevel::Info)) {
+        std::cout << "Streaming decode: the recursive blur needs whole images, using the exact Gaussian instead" << std::endl;
+    }
+    if (savesAlignedImages(options)) {
+        alignedWriter.emplace(options, 3 * static_cast<size_t>(queueDepth));
+    } else if (options.alignedImageFormat != AlignedImageFormat::None && logEnabled(LogLevel::Info)) {
+        std::cout << (streamRows ? "Streaming decode: whole images are never held, skipping aligned image output"
+                                 : "Streaming blur: blurred images are not stored, skipping aligned image output") << std::endl;
+    }
+
+    std::thread decodeStage([&] {
+        for (int rpm : uniqueRPMs) {
+            PendingGroup group{rpm, {}, {}, std::nullopt, 0};
+            std::vector<std::string> filenames = getReplicateFilenames(index, identifier, rpm);
+            if (options.columnCache) {
+                // Aligned images need the pixels, so with them the cache is only written
+                group.cacheKey = getColumnCacheKey(folderPath, filenames);
+                if (group.cacheKey != 0 && !alignedWriter) {
+                    group.cached = loadCachedProfiles(getColumnCachePath(outputFolder, identifier, rpm, options),
+                                                      group.cacheKey, rpm);
+                }
+            }
+            if (group.cached) {
+                // Nothing to decode
+            } else if (streamRows) {
+                group.streamedProfiles = submitStreamedReductions(filenames, folderPath, rpm, options,
+                                                                  getReductionMask(options, group.cacheKey), decodePool);
+            } else {
+                for (const auto& filename : filenames) {
+                    group.images.push_back(decodePool.submit([folderPath, filename, options] {
+                        return decodeImage(folderPath, filename, options);
+                    }));
+                }
+            }
+            if (!decodeQueue.push(std::move(group))) {
+                break;
+            }
+        }
+        decodeQueue.close();
+    });
+
+    std::map<int, std::vector<std::string>> writtenRPMs;
+    std::thread writeStage([&] {
+        while (std::optional<RPMProfiles> result = writeQueue.pop()) {
+            if (result->cacheKey != 0) {
+                storeCachedProfiles(getColumnCachePath(outputFolder, identifier, result->rpm, options), *result);
+            }
+            if (writeRPMProfiles(*result, outputFolder, identifier, options)) {
+                writtenRPMs[result->rpm] = std::move(result->alignedImages);
+            }
+        }
+    });
+
+    // An exception here (e.g. a cv::Exception from an unexpected image) must not leave the stage threads
+    // joinable: stop the decode stage, let the write stage finish the groups already reduced, and join both.
+    // The groups not written are missing from the result, so they are retried next time.
+    try {
+        while (std::optional<PendingGroup> group = decodeQueue.pop()) {
+            if (group->cached) {
+                if (logEnabled(LogLevel::Info)) {
+                    std::cout << "Using cached column profiles for RPM: " << group->rpm << std::endl;
+                }
+                writeQueue.push(std::move(*group->cached));
+                continue;
+            }
+            if (streamRows) {
+                if (std::optional<RPMProfiles> result = collectStreamedProfiles(group->streamedProfiles, group->rpm)) {
+                    result->cacheKey = group->cacheKey;
+                    writeQueue.push(std::move(*result));
+                }
+                continue;
+            }
+
+            std::vector<DecodedImage> decodedImages;
+            {
+                TraceScope trace("Wait for decode");
+                trace.rpm = group->rpm;
+                for (auto& pending : group->images) {
+                    decodedImages.push_back(pending.get());
+                }
+            }
+            if (std::optional<RPMProfiles> result = processRPMImages(decodedImages, group->rpm, outputFolder, identifier, options,
+                                                                     getReductionMask(options, group->cacheKey),
+                                                                     alignedWriter ? &*alignedWriter : nullptr)) {
+                result->cacheKey = group->cacheKey;
+                writeQueue.push(std::move(*result));
+            }
+        }
+    } catch (const std::exception& exception) {
+        std::cerr << "Error: Stopped processing dataset " << identifier << ": " << exception.what() << std::endl;
+        decodeQueue.close();
+    }
+    writeQueue.close();
+
+    decodeStage.join();
+    writeStage.join();
+
+    // A group whose aligned images could not all be saved is not recorded, so it is retried next time
+    if (alignedWriter) {
+        for (int rpm : alignedWriter->finish()) {
+            writtenRPMs.erase(rpm);
+        }
+    }
+    return writtenRPMs;
+}
+
+// Bounded lock-free queue of log text with many producers and one consumer (after Dmitry Vyukov's
+// bounded MPMC queue). Each slot carries a sequence number that tells producers and the consumer
+// whose turn it is, so pushing a line is a CAS on the enqueue position plus a string move.
+class LogRing {
+    struct Slot {
+        std::atomic<size_t> sequence{0};
+        std::string text;
+    };
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> enqueuePosition{0};
+    alignas(64) size_t dequeuePosition = 0;
+
+public:
+    // capacity must be a power of two
+    explicit LogRing(size_t capacity) : slots(new Slot[capacity]), mask(capacity - 1) {
+        for (size_t i = 0; i < capacity; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Returns false if the ring is full; on success text is moved out and position is its slot number
+    bool tryPush(std::string& text, size_t& position) {
+        size_t pos = enqueuePosition.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[pos & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<std::ptrdiff_t>(sequence - pos);
+            if (difference == 0) {
+                if (enqueuePosition.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.text = std::move(text);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    position = pos;
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                pos = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
     }
 
-    csvFile.close();
-    std::cout << "Processed RPM " << rpm << " and saved " << channelName 
-              << " data to: " << csvFilePath << std::endl;
-}
+    // Single consumer only
+    bool tryPop(std::string& text) {
+        Slot& slot = slots[dequeuePosition & mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (static_cast<std::ptrdiff_t>(sequence - (dequeuePosition + 1)) < 0) {
+            return false;
+        }
+        text = std::move(slot.text);
+        slot.sequence.store(dequeuePosition + mask + 1, std::memory_order_release);
+        ++dequeuePosition;
+        return true;
+    }
+};
 
-// Add this class definition before initializeLogging function
+// Stream buffer behind std::cout that copies all output to the log file as well.
+// Text is collected in a per-thread buffer; complete lines are pushed onto a lock-free ring and
+// written to both sinks by a background thread, so threads printing progress never wait on console
+// or file I/O (only if the ring is full) and lines from concurrent stages never interleave.
+// sync (std::endl, std::flush, reading std::cin) also pushes an unfinished line, e.g. a prompt, and
+// waits for it to reach the console; the log file is flushed by its own buffer and on exit.
 class DualStreamBuffer : public std::streambuf {
     std::streambuf *console, *file;
+    LogRing ring{4096};
+    std::thread writer;
+    std::atomic<bool> stopping{false};
+    std::atomic<unsigned> wakeSignal{0};
+    std::atomic<size_t> writtenCount{0};
     static DualStreamBuffer* instance;
-    
+    static thread_local std::string pendingText;
+
     DualStreamBuffer() : console(nullptr), file(nullptr) {}
-    
+
 public:
     static DualStreamBuffer* getInstance() {
         if (!instance) {
@@ -251,24 +3383,129 @@ public:
         }
         return instance;
     }
-    
+
+    // Function to set the sinks and start the background writer; call once, before other threads log
     void init(std::streambuf* c, std::streambuf* f) {
         console = c;
         file = f;
+        writer = std::thread([this] { writerLoop(); });
     }
-    
+
+    // Function to write everything still queued and stop the background writer
+    void stop() {
+        if (!writer.joinable()) {
+            return;
+        }
+        stopping = true;
+        wake();
+        writer.join();
+    }
+
 protected:
     int overflow(int c) override {
         if (c != EOF) {
-            console->sputc(c);
-            file->sputc(c);
+            pendingText.push_back(static_cast<char>(c));
+            if (c == '\n') {
+                pushPending(false);
+            }
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        pendingText.append(s, static_cast<size_t>(n));
+        if (std::memchr(s, '\n', static_cast<size_t>(n))) {
+            pushPending(false);
+        }
+        return n;
+    }
+
+    int sync() override {
+        pushPending(true);
+        return 0;
+    }
+
+private:
+    // Function to queue this thread's complete lines, or with includePartial all of its text. Without a
+    // running writer (before init, after stop) the text is written directly to the console.
+    void pushPending(bool includePartial) {
+        size_t lineEnd = pendingText.rfind('\n');
+        size_t length = includePartial ? pendingText.size() : (lineEnd == std::string::npos ? 0 : lineEnd + 1);
+        if (length == 0) {
+            return;
+        }
+        std::string text = pendingText.substr(0, length);
+        pendingText.erase(0, length);
+        bool unfinishedLine = text.back() != '\n';
+
+        if (!writer.joinable() || stopping) {
+            if (console) {
+                console->sputn(text.data(), static_cast<std::streamsize>(text.size()));
+                console->pubsync();
+            }
+            return;
+        }
+
+        size_t position;
+        while (!ring.tryPush(text, position)) {
+            wake();
+            std::this_thread::yield();
+        }
+        wake();
+
+        // An unfinished line is usually a prompt; wait until it is on the console
+        if (unfinishedLine) {
+            for (size_t written = writtenCount.load(); written <= position; written = writtenCount.load()) {
+                writtenCount.wait(written);
+            }
+        }
+    }
+
+    // Function to tell the writer there is new text; notify_one is cheap while the writer is busy
+    void wake() {
+        wakeSignal.fetch_add(1, std::memory_order_release);
+        wakeSignal.notify_one();
+    }
+
+    void writerLoop() {
+        std::string text;
+        for (;;) {
+            // Any push before this load is visible to the pops below; any push after it changes wakeSignal
+            unsigned signal = wakeSignal.load(std::memory_order_acquire);
+            size_t count = 0;
+            while (ring.tryPop(text)) {
+                auto size = static_cast<std::streamsize>(text.size());
+                if (console) console->sputn(text.data(), size);
+                if (file) file->sputn(text.data(), size);
+                ++count;
+            }
+            if (count > 0) {
+                if (console) console->pubsync();
+                writtenCount.fetch_add(count);
+                writtenCount.notify_all();
+                continue;
+            }
+            if (stopping) {
+                return;
+            }
+
+            wakeSignal.wait(signal, std::memory_order_acquire);
         }
-        return c;
     }
 };
 
 DualStreamBuffer* DualStreamBuffer::instance = nullptr;
+thread_local std::string DualStreamBuffer::pendingText;
 static std::ofstream g_logFile;
+static std::streambuf* g_consoleBuffer = nullptr;
+
+// Function to drain the log and give std::cout its console buffer back before g_logFile is destroyed
+void shutdownLogging() {
+    std::cout.flush();
+    DualStreamBuffer::getInstance()->stop();
+    std::cout.rdbuf(g_consoleBuffer);
+    g_logFile.flush();
+}
 
 void initializeLogging(const std::string& identifier) {
     fs::create_directory("logs");
@@ -281,24 +3518,287 @@ void initializeLogging(const std::string& identifier) {
     filename += ".txt";
     
     g_logFile.open(filename);
+    g_consoleBuffer = std::cout.rdbuf();
     auto buffer = DualStreamBuffer::getInstance();
-    buffer->init(std::cout.rdbuf(), g_logFile.rdbuf());
+    buffer->init(g_consoleBuffer, g_logFile.rdbuf());
     std::cout.rdbuf(buffer);
+    std::atexit(shutdownLogging);
 }
 
-int main() {
-    // Ask user for the identifier
+// One dataset to analyze: which images to read, where to write and how to process them
+struct JobConfig {
     std::string identifier;
-    std::cout << "Enter the identifier for the dataset (e.g., W, SF, etc.): ";
-    std::cin >> identifier;
-    
-    // Initialize logging after getting the identifier
-    initializeLogging(identifier);
-    
+    std::string inputFolder;
+    std::string outputFolder;
+    ProcessingOptions options;
+};
+
+// Function to parse a blur method given as G/F/S or gaussian/recursive/streaming
+bool parseBlurMethod(const std::string& text, BlurMethod& method) {
+    std::string lower = text;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (lower == "g" || lower == "gaussian") {
+        method = BlurMethod::Gaussian;
+    } else if (lower == "f" || lower == "recursive") {
+        method = BlurMethod::Recursive;
+    } else if (lower == "s" || lower == "streaming") {
+        method = BlurMethod::Streaming;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Function to parse an aligned image format given as none/float/16/8
+bool parseAlignedImageFormat(const std::string& text, AlignedImageFormat& format) {
+    std::string lower = text;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (lower == "n" || lower == "none") {
+        format = AlignedImageFormat::None;
+    } else if (lower == "f" || lower == "float") {
+        format = AlignedImageFormat::Float32;
+    } else if (lower == "16") {
+        format = AlignedImageFormat::UInt16;
+    } else if (lower == "8") {
+        format = AlignedImageFormat::UInt8;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Function to parse a TIFF compression given as none/lzw/deflate
+bool parseTiffCompression(const std::string& text, TiffCompression& compression) {
+    std::string lower = text;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (lower == "none") {
+        compression = TiffCompression::None;
+    } else if (lower == "lzw") {
+        compression = TiffCompression::LZW;
+    } else if (lower == "deflate") {
+        compression = TiffCompression::Deflate;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Function to parse the binary profile formats given as none/npy/mat/both
+bool parseProfileBinaryFormat(const std::string& text, ProfileBinaryFormat& format) {
+    std::string lower = text;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (lower == "none") {
+        format = ProfileBinaryFormat::None;
+    } else if (lower == "npy") {
+        format = ProfileBinaryFormat::Npy;
+    } else if (lower == "mat") {
+        format = ProfileBinaryFormat::Mat;
+    } else if (lower == "both") {
+        format = ProfileBinaryFormat::Both;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Function to parse a whole string as a finite number, rejecting trailing characters, NaN and infinities
+bool parseNumber(const std::string& text, double& value) {
+    char* end = nullptr;
+    double number = std::strtod(text.c_str(), &end);
+    if (text.empty() || end != text.c_str() + text.size() || !std::isfinite(number)) {
+        return false;
+    }
+    value = number;
+    return true;
+}
+
+// Function to check that a number is a whole number that fits in an int, so that casting it is defined
+bool isIntegerValue(double number) {
+    return std::isfinite(number) && number == std::trunc(number) &&
+           number >= std::numeric_limits<int>::min() && number <= std::numeric_limits<int>::max();
+}
+
+// Function to parse a whole string as an int, rejecting fractions and values out of range
+bool parseInteger(const std::string& text, int& value) {
+    double number = 0.0;
+    if (!parseNumber(text, number) || !isIntegerValue(number)) {
+        return false;
+    }
+    value = static_cast<int>(number);
+    return true;
+}
+
+// Functions to read a numeric job file key, if present, rejecting NaN, infinities and (for ints)
+// fractions and values out of range
+bool readNodeNumber(const cv::FileNode& node, const char* key, double& value) {
+    if (node[key].empty()) {
+        return true;
+    }
+    double number = static_cast<double>(node[key]);
+    if (!std::isfinite(number)) {
+        std::cerr << "Error: Invalid number for " << key << " in job file." << std::endl;
+        return false;
+    }
+    value = number;
+    return true;
+}
+
+bool readNodeInteger(const cv::FileNode& node, const char* key, int& value) {
+    if (node[key].empty()) {
+        return true;
+    }
+    double number = static_cast<double>(node[key]);
+    if (!isIntegerValue(number)) {
+        std::cerr << "Error: Invalid integer for " << key << " in job file." << std::endl;
+        return false;
+    }
+    value = static_cast<int>(number);
+    return true;
+}
+
+bool readNodeSwitch(const cv::FileNode& node, const char* key, bool& value) {
+    int number = value ? 1 : 0;
+    if (!readNodeInteger(node, key, number)) {
+        return false;
+    }
+    value = number != 0;
+    return true;
+}
+
+// Function to check that a job is complete and its parameters are in range
+bool validateJob(const JobConfig& job) {
+    std::string name = job.identifier.empty() ? "<unnamed>" : job.identifier;
+    if (job.identifier.empty() || job.inputFolder.empty() || job.outputFolder.empty()) {
+        std::cerr << "Error: Job " << name << " needs an identifier, an input folder and an output folder." << std::endl;
+        return false;
+    }
+    const ProcessingOptions& options = job.options;
+    if (!std::isfinite(options.distanceUpper) || !std::isfinite(options.distanceLower)) {
+        std::cerr << "Error: Job " << name << ": distance bounds must be finite numbers." << std::endl;
+        return false;
+    }
+    if (options.distanceLower >= options.distanceUpper) {
+        std::cerr << "Error: Job " << name << ": lower bound must be less than upper bound (" << options.distanceUpper << ")." << std::endl;
+        return false;
+    }
+    if (std::string("RGBA").find(options.channelChoice) == std::string::npos) {
+        std::cerr << "Error: Job " << name << ": channel must be R, G, B, or A." << std::endl;
+        return false;
+    }
+    if (options.blurRadius < 0) {
+        std::cerr << "Error: Job " << name << ": blur radius must be non-negative." << std::endl;
+        return false;
+    }
+    if (options.alignedImageWidth < 0) {
+        std::cerr << "Error: Job " << name << ": aligned image width must be non-negative." << std::endl;
+        return false;
+    }
+    if (options.streamRows < 0) {
+        std::cerr << "Error: Job " << name << ": stream rows must be non-negative." << std::endl;
+        return false;
+    }
+    if (options.previewScale != 1 && options.previewScale != 2 && options.previewScale != 4 && options.previewScale != 8) {
+        std::cerr << "Error: Job " << name << ": preview scale must be 1 (off), 2, 4 or 8." << std::endl;
+        return false;
+    }
+    if (options.csvPrecision < 0 || options.csvPrecision > 17) {
+        std::cerr << "Error: Job " << name << ": CSV precision must be 0 (shortest round-trip) to 17 digits." << std::endl;
+        return false;
+    }
+    if (options.previewScale > 1 && options.streamRows > 0) {
+        std::cerr << "Error: Job " << name << ": preview and stream rows cannot be combined." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to read job settings from a cv::FileStorage node, keeping the current values for missing keys
+bool readJobNode(const cv::FileNode& node, JobConfig& job) {
+    if (!node["identifier"].empty()) job.identifier = static_cast<std::string>(node["identifier"]);
+    if (!node["input"].empty()) job.inputFolder = static_cast<std::string>(node["input"]);
+    if (!node["output"].empty()) job.outputFolder = static_cast<std::string>(node["output"]);
+    if (!readNodeNumber(node, "distanceUpper", job.options.distanceUpper) ||
+        !readNodeNumber(node, "distanceLower", job.options.distanceLower) ||
+        !readNodeInteger(node, "blurRadius", job.options.blurRadius)) {
+        return false;
+    }
+    if (!node["channel"].empty()) {
+        std::string channel = static_cast<std::string>(node["channel"]);
+        job.options.channelChoice = channel.empty() ? ' ' : static_cast<char>(std::toupper(channel[0]));
+    }
+    if (!node["blurMethod"].empty() && !parseBlurMethod(static_cast<std::string>(node["blurMethod"]), job.options.blurMethod)) {
+        std::cerr << "Error: Unknown blur method: " << static_cast<std::string>(node["blurMethod"]) << std::endl;
+        return false;
+    }
+    if (!node["alignedImages"].empty() &&
+        !parseAlignedImageFormat(static_cast<std::string>(node["alignedImages"]), job.options.alignedImageFormat)) {
+        std::cerr << "Error: Unknown aligned image format: " << static_cast<std::string>(node["alignedImages"]) << std::endl;
+        return false;
+    }
+    if (!node["alignedCompression"].empty() &&
+        !parseTiffCompression(static_cast<std::string>(node["alignedCompression"]), job.options.alignedImageCompression)) {
+        std::cerr << "Error: Unknown TIFF compression: " << static_cast<std::string>(node["alignedCompression"]) << std::endl;
+        return false;
+    }
+    if (!readNodeInteger(node, "alignedWidth", job.options.alignedImageWidth) ||
+        !readNodeInteger(node, "streamRows", job.options.streamRows) ||
+        !readNodeSwitch(node, "memoryMap", job.options.memoryMap) ||
+        !readNodeInteger(node, "preview", job.options.previewScale) ||
+        !readNodeSwitch(node, "columnCache", job.options.columnCache) ||
+        !readNodeSwitch(node, "incremental", job.options.incremental) ||
+        !readNodeInteger(node, "csvPrecision", job.options.csvPrecision)) {
+        return false;
+    }
+    if (!node["binaryProfiles"].empty() &&
+        !parseProfileBinaryFormat(static_cast<std::string>(node["binaryProfiles"]), job.options.binaryProfiles)) {
+        std::cerr << "Error: Unknown binary profile format: " << static_cast<std::string>(node["binaryProfiles"]) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to load a JSON or YAML job file listing many datasets. Keys in the optional "defaults"
+// map apply to every entry of the "jobs" list unless the entry overrides them, e.g.
+// {"defaults": {"distanceUpper": 144, "distanceLower": 24, "channel": "A", "blurRadius": 10},
+//  "jobs": [{"identifier": "W", "input": "in/W", "output": "out/W"}, ...]}
+bool loadJobFile(const std::string& path, const JobConfig& base, std::vector<JobConfig>& jobs) {
+    // cv::FileStorage throws on malformed JSON/YAML, both when parsing the file and when reading its nodes
+    try {
+        cv::FileStorage storage(path, cv::FileStorage::READ);
+        if (!storage.isOpened()) {
+            std::cerr << "Error: Could not open job file: " << path << std::endl;
+            return false;
+        }
+
+        JobConfig defaults = base;
+        if (!readJobNode(storage["defaults"], defaults)) {
+            return false;
+        }
+        cv::FileNode jobList = storage["jobs"];
+        if (!jobList.isSeq()) {
+            std::cerr << "Error: Job file " << path << " has no \"jobs\" list." << std::endl;
+            return false;
+        }
+        for (const auto& node : jobList) {
+            JobConfig job = defaults;
+            if (!readJobNode(node, job)) {
+                return false;
+            }
+            jobs.push_back(job);
+        }
+        return true;
+    } catch (const cv::Exception& exception) {
+        std::cerr << "Error: Could not read job file " << path << ": " << exception.what() << std::endl;
+        return false;
+    }
+}
+
+// Function to ask the user for a job's analysis parameters and folders
+void promptForJob(JobConfig& job) {
     // Get and validate distance bounds
     double distanceUpper, distanceLower;
     bool validInput = false;
-    
+
     // Get Upper bound
     do {
         std::cout << "Please specify Distance Upperbound (Distance at left side of all images): ";
@@ -310,10 +3810,10 @@ int main() {
             std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
         }
     } while (!validInput);
-    
+
     // Reset for lower bound input
     validInput = false;
-    
+
     // Get Lower bound
     do {
         std::cout << "Please specify Distance Lowerbound (Distance at right side of all images): ";
@@ -329,18 +3829,18 @@ int main() {
             std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
         }
     } while (!validInput);
-    
+
     // Get color channel choice
     char channelChoice;
     bool validChannel = false;
     do {
-        std::cout << "Specify channel to analyze (R/G/B): ";
+        std::cout << "Specify channel to analyze (R/G/B, or A for all three from a single pass): ";
         std::cin >> channelChoice;
         channelChoice = std::toupper(channelChoice);  // Convert to uppercase
-        if (channelChoice == 'R' || channelChoice == 'G' || channelChoice == 'B') {
+        if (channelChoice == 'R' || channelChoice == 'G' || channelChoice == 'B' || channelChoice == 'A') {
             validChannel = true;
         } else {
-            std::cout << "Error: Please enter R, G, or B.\n";
+            std::cout << "Error: Please enter R, G, B, or A.\n";
             std::cin.clear();
             std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
         }
@@ -363,30 +3863,580 @@ int main() {
             std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
         }
     } while (!validRadius);
-    
+
+    // Get blur method
+    BlurMethod blurMethod = BlurMethod::Gaussian;
+    if (blurRadius > 0) {
+        std::string methodChoice;
+        bool validMethod = false;
+        do {
+            std::cout << "Specify blur method (G = exact Gaussian, F = fast recursive Gaussian for large radii, "
+                      << "S = exact Gaussian streamed into the reduction, no aligned images saved): ";
+            std::cin >> methodChoice;
+            if (methodChoice.size() == 1 && parseBlurMethod(methodChoice, blurMethod)) {
+                validMethod = true;
+            } else {
+                std::cout << "Error: Please enter G, F, or S.\n";
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+        } while (!validMethod);
+    }
+
+    // Ask whether to save the aligned images for verification (never stored by the streaming blur)
+    AlignedImageFormat alignedImageFormat = AlignedImageFormat::None;
+    if (blurRadius == 0 || blurMethod != BlurMethod::Streaming) {
+        std::string formatChoice;
+        bool validFormat = false;
+        do {
+            std::cout << "Save aligned images for verification? (N = no, F = 32-bit float, 16 = 16-bit, 8 = 8-bit): ";
+            std::cin >> formatChoice;
+            if (parseAlignedImageFormat(formatChoice, alignedImageFormat)) {
+                validFormat = true;
+            } else {
+                std::cout << "Error: Please enter N, F, 16, or 8.\n";
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+        } while (!validFormat);
+    }
+
+    job.options.distanceUpper = distanceUpper;
+    job.options.distanceLower = distanceLower;
+    job.options.channelChoice = channelChoice;
+    job.options.blurRadius = blurRadius;
+    job.options.blurMethod = blurMethod;
+    job.options.alignedImageFormat = alignedImageFormat;
+
     // Ask user for input and output folder paths
-    std::string folderPath, outputFolder;
     std::cout << "Enter the path to the input folder: ";
-    std::cin >> folderPath;
+    std::cin >> job.inputFolder;
     std::cout << "Enter the path to the output folder: ";
-    std::cin >> outputFolder;
+    std::cin >> job.outputFolder;
+}
+
+// Function to run one dataset through the RPM pipeline, decoding on the shared pool. In watch mode
+// settledFiles lists the completely written files of the input folder, which are used instead of
+// scanning it, and groups still waiting for replicates are left for a later pass.
+bool runJob(const JobConfig& job, ThreadPool& decodePool, int queueDepth,
+            const std::vector<std::string>* settledFiles = nullptr, bool* blurDeviationReported = nullptr) {
+    const std::string& identifier = job.identifier;
+    ProcessingOptions options = job.options;
+    TraceScope trace("Dataset");
+    trace.label = &identifier;
+    if (logEnabled(LogLevel::Info) && !settledFiles) {
+        std::cout << "Starting dataset " << identifier << ": " << job.inputFolder << " -> " << job.outputFolder << std::endl;
+    }
+
+    // A preview blurs with the radius scaled to its resolution, so it approximates the full-resolution blur
+    if (options.previewScale > 1) {
+        if (options.blurRadius > 0) {
+            options.blurRadius = std::max(1, (options.blurRadius + options.previewScale / 2) / options.previewScale);
+        }
+        if (logEnabled(LogLevel::Info) && !settledFiles) {
+            std::cout << "Preview at 1/" << options.previewScale << " resolution, blur radius " << options.blurRadius << std::endl;
+        }
+    }
 
-    // Get filenames in the folder
-    std::vector<std::string> filenames = getFilenames(folderPath);
+    // Get filenames in the folder and index them by identifier, RPM and replicate
+    std::error_code error;
+    if (!fs::is_directory(job.inputFolder, error)) {
+        std::cerr << "Error: Input folder does not exist: " << job.inputFolder << std::endl;
+        return false;
+    }
+    fs::create_directories(job.outputFolder, error);
+    if (options.previewScale > 1) {
+        fs::create_directories(job.outputFolder + "/" + kPreviewFolder, error);
+    }
+    FilenameIndex index;
+    if (settledFiles) {
+        index = buildFilenameIndex(*settledFiles);
+    } else {
+        StageTimer timer(Stage::Scan);
+        index = buildFilenameIndex(getFilenames(job.inputFolder));
+    }
 
     // Extract unique RPMs
-    std::vector<int> uniqueRPMs = extractUniqueRPMs(filenames, identifier);
+    std::vector<int> uniqueRPMs = extractUniqueRPMs(index, identifier);
+    bool skippedGroups = false;
+    if (settledFiles) {
+        // Groups still being shot wait for their replicates; a group with extra files (a fourth replicate,
+        // or one replicate in two formats) is reported and skipped, so the other groups keep being processed
+        const auto* groups = findRPMGroups(index, identifier);
+        std::erase_if(uniqueRPMs, [&](int rpm) {
+            size_t replicates = groups->at(rpm).size();
+            if (replicates > 3) {
+                std::cerr << "Error: RPM " << rpm << " has " << replicates << " replicate files instead of 3, skipping it.\n";
+                skippedGroups = true;
+            }
+            return replicates != 3;
+        });
+    }
 
     // Validate replicates
-    if (!validateReplicates(filenames, uniqueRPMs, identifier)) {
-        return -1;
+    if (!validateReplicates(index, uniqueRPMs, identifier)) {
+        return false;
     }
 
-    // Process each RPM
-    for (const auto& rpm : uniqueRPMs) {
-        processRPMImages(filenames, folderPath, rpm, outputFolder, identifier, 
-                        distanceUpper, distanceLower, channelChoice, blurRadius);
+    // Find the groups whose CSVs or aligned images are missing or were made from other inputs or parameters
+    std::string manifestPath = getManifestPath(job.outputFolder, identifier);
+    BuildManifest manifest = loadBuildManifest(manifestPath);
+    uint64_t parameterKey = getParameterKey(options);
+    std::map<int, uint64_t> inputKeys;
+    std::vector<int> staleRPMs;
+    for (int rpm : uniqueRPMs) {
+        inputKeys[rpm] = getColumnCacheKey(job.inputFolder, getReplicateFilenames(index, identifier, rpm));
+        if (!options.incremental ||
+            !isRPMGroupUpToDate(manifest, job.outputFolder, identifier, rpm, inputKeys[rpm], parameterKey, options)) {
+            staleRPMs.push_back(rpm);
+        }
+    }
+    if (logEnabled(LogLevel::Info) && staleRPMs.size() < uniqueRPMs.size() && !settledFiles) {
+        std::cout << "Up to date: " << (uniqueRPMs.size() - staleRPMs.size()) << " of " << uniqueRPMs.size()
+                  << " RPM groups, rebuilding " << staleRPMs.size() << std::endl;
+    }
+    if (settledFiles && staleRPMs.empty()) {
+        return !skippedGroups;
     }
 
-    return 0;
+    // Report how far the recursive blur is from the exact Gaussian, using the first image. The check
+    // decodes that image once more and runs the exact blur the recursive one avoids, so it is a debug
+    // diagnostic, made once per job (not on every watch pass).
+    if (options.blurMethod == BlurMethod::Recursive && options.blurRadius > 0 && options.streamRows == 0
+        && !staleRPMs.empty() && logEnabled(LogLevel::Debug) && !(blurDeviationReported && *blurDeviationReported)) {
+        std::vector<std::string> firstGroup = getReplicateFilenames(index, identifier, staleRPMs.front());
+        DecodedImage decoded = decodeImage(job.inputFolder, firstGroup.front(), options);
+        if (!decoded.image.empty()) {
+            reportBlurDeviation(decoded.image, options.blurRadius);
+        }
+        if (blurDeviationReported) {
+            *blurDeviationReported = true;
+        }
+    }
+
+    // Decode, reduce and write the stale RPM groups as a pipeline, then record what was written. Groups
+    // that failed lose their entries, so they are retried next time.
+    std::map<int, std::vector<std::string>> writtenRPMs = runRPMPipeline(index, staleRPMs, job.inputFolder, job.outputFolder,
+                                                                         identifier, options, decodePool, queueDepth);
+    int channelMask = getChannelMask(options.channelChoice);
+    uint64_t alignedKey = getAlignedImageKey(options);
+    for (int rpm : staleRPMs) {
+        auto writtenGroup = writtenRPMs.find(rpm);
+        bool written = writtenGroup != writtenRPMs.end();
+        std::string alignedPrefix = getAlignedImagePrefix(identifier, rpm);
+        std::erase_if(manifest, [&](const auto& entry) { return entry.first.starts_with(alignedPrefix); });
+        if (written) {
+            for (const auto& name : writtenGroup->second) {
+                manifest[name] = {inputKeys[rpm], alignedKey};
+            }
+        }
+        for (char channel : {'R', 'G', 'B'}) {
+            if ((channelMask >> getChannelIndex(channel)) & 1) {
+                std::string name = getProfileCSVName(identifier, rpm, channel, options);
+                if (written) {
+                    manifest[name] = {inputKeys[rpm], parameterKey};
+                } else {
+                    manifest.erase(name);
+                }
+            }
+        }
+    }
+    if (!staleRPMs.empty()) {
+        saveBuildManifest(manifestPath, manifest);
+    }
+    if (logEnabled(LogLevel::Info) && !settledFiles) {
+        std::cout << "Finished dataset " << identifier << std::endl;
+    }
+    return !skippedGroups;
+}
+
+// Set by Ctrl+C in watch mode, so that the watchers stop and the run ends normally
+// (a lock-free atomic, so the signal handler may set it while watcher threads read it)
+static std::atomic<bool> g_stopWatching{false};
+
+void stopWatching(int) {
+    g_stopWatching.store(true, std::memory_order_relaxed);
+    std::signal(SIGINT, SIG_DFL);  // a second Ctrl+C ends the program even in the middle of a pass
+}
+
+// How long a watcher waits for changes before checking for Ctrl+C; when polling, also the time a file
+// must stay unchanged to count as written
+constexpr int kWatchIntervalMs = 500;
+
+// Tracks which files of a folder have been completely written. On Linux inotify reports each file as it
+// is closed after writing or moved into the folder; elsewhere (or if inotify is unavailable) the folder
+// is polled and a file counts as written once its size and modification time stop changing.
+class FolderWatcher {
+public:
+    explicit FolderWatcher(std::string watchedFolder) : folder(std::move(watchedFolder)) {
+#ifdef __linux__
+        descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (descriptor >= 0 && inotify_add_watch(descriptor, folder.c_str(),
+                IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE | IN_MODIFY) >= 0) {
+            // Watching first, then scanning, so nothing written in between is missed
+            for (const auto& filename : getFilenames(folder)) {
+                settled.insert(filename);
+            }
+            return;
+        }
+        if (descriptor >= 0) {
+            close(descriptor);
+            descriptor = -1;
+        }
+#endif
+        poll();
+    }
+
+    ~FolderWatcher() {
+#ifdef __linux__
+        if (descriptor >= 0) {
+            close(descriptor);
+        }
+#endif
+    }
+
+    // Function to wait up to kWatchIntervalMs for changes; returns true if files were newly written
+    bool waitForChanges() {
+#ifdef __linux__
+        if (descriptor >= 0) {
+            return readEvents();
+        }
+#endif
+        std::this_thread::sleep_for(std::chrono::milliseconds(kWatchIntervalMs));
+        return poll();
+    }
+
+    std::vector<std::string> settledFiles() const {
+        return {settled.begin(), settled.end()};
+    }
+
+private:
+    // Function to rescan the folder, settling files that have not changed since the previous scan
+    bool poll() {
+        std::map<std::string, std::pair<uintmax_t, fs::file_time_type>> seen;
+        bool changed = false;
+        std::error_code error;
+        for (const auto& entry : fs::directory_iterator(folder, error)) {
+            if (!entry.is_regular_file(error)) {
+                continue;
+            }
+            std::string filename = entry.path().filename().string();
+            auto state = std::make_pair(entry.file_size(error), entry.last_write_time(error));
+            auto previous = lastSeen.find(filename);
+            if (previous != lastSeen.end() && previous->second == state) {
+                changed = settled.insert(filename).second || changed;
+            } else {
+                settled.erase(filename);
+            }
+            seen.emplace(filename, state);
+        }
+        std::erase_if(settled, [&seen](const std::string& filename) { return !seen.count(filename); });
+        lastSeen = std::move(seen);
+        return changed;
+    }
+
+#ifdef __linux__
+    // Function to wait for and apply inotify events: files being written are unsettled until closed
+    bool readEvents() {
+        pollfd waiting{descriptor, POLLIN, 0};
+        if (::poll(&waiting, 1, kWatchIntervalMs) <= 0) {
+            return false;
+        }
+        bool changed = false;
+        alignas(inotify_event) char buffer[4096];
+        for (ssize_t length; (length = read(descriptor, buffer, sizeof(buffer))) > 0;) {
+            for (char* next = buffer; next < buffer + length;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(next);
+                next += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    // Events were lost; take the folder as it is now
+                    for (const auto& filename : getFilenames(folder)) {
+                        changed = settled.insert(filename).second || changed;
+                    }
+                    continue;
+                }
+                if (event->len == 0 || (event->mask & IN_ISDIR)) {
+                    continue;
+                }
+                std::string filename = event->name;
+                if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                    settled.insert(filename);
+                    changed = true;  // also when a settled file was rewritten (a re-shot replicate)
+                } else {
+                    settled.erase(filename);
+                }
+            }
+        }
+        return changed;
+    }
+
+    int descriptor = -1;
+#endif
+
+    std::string folder;
+    std::set<std::string> settled;
+    std::map<std::string, std::pair<uintmax_t, fs::file_time_type>> lastSeen;
+};
+
+// Function to watch a dataset's input folder until Ctrl+C, processing each RPM group as soon as all
+// its replicates have been written (and again whenever one of them is rewritten)
+bool watchJob(const JobConfig& job, ThreadPool& decodePool, int queueDepth) {
+    JobConfig watchedJob = job;
+    // The manifest records the CSVs and aligned images already written, so each pass processes only new or
+    // rewritten groups
+    watchedJob.options.incremental = true;
+    std::error_code error;
+    if (!fs::is_directory(job.inputFolder, error)) {
+        std::cerr << "Error: Input folder does not exist: " << job.inputFolder << std::endl;
+        return false;
+    }
+    FolderWatcher watcher(job.inputFolder);
+    if (logEnabled(LogLevel::Info)) {
+        std::cout << "Watching " << job.inputFolder << " for dataset " << job.identifier << " -> "
+                  << job.outputFolder << " (Ctrl+C to stop)" << std::endl;
+    }
+
+    bool succeeded = true;
+    bool blurDeviationReported = false;
+    for (bool changed = true; !g_stopWatching; changed = watcher.waitForChanges()) {
+        if (changed) {
+            std::vector<std::string> settledFiles = watcher.settledFiles();
+            succeeded = runJob(watchedJob, decodePool, queueDepth, &settledFiles, &blurDeviationReported) && succeeded;
+        }
+    }
+    if (logEnabled(LogLevel::Info)) {
+        std::cout << "Stopped watching " << job.inputFolder << std::endl;
+    }
+    return succeeded;
+}
+
+// Function to set the global log level from quiet/info/debug
+bool parseLogLevel(const std::string& text) {
+    if (text == "quiet") {
+        g_logLevel = LogLevel::Quiet;
+    } else if (text == "info") {
+        g_logLevel = LogLevel::Info;
+    } else if (text == "debug") {
+        g_logLevel = LogLevel::Debug;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void printUsage() {
+    std::cout << "Usage: DyeGradienttoCSV [options]\n"
+              << "Without dataset options or a job file, the parameters are asked for interactively.\n"
+              << "  --identifier ID        dataset identifier (e.g. W, SF)\n"
+              << "  --input DIR            folder with the <ID>_<RPM>_R<n> images\n"
+              << "  --output DIR           folder for the CSV files\n"
+              << "  --upper CM             distance at the left side of all images\n"
+              << "  --lower CM             distance at the right side of all images\n"
+              << "  --channel R|G|B|A      channel to analyze, A for all three (default R)\n"
+              << "  --blur-radius N        Gaussian blur radius, 0 for no blur (default 10)\n"
+              << "  --blur-method G|F|S    exact Gaussian, fast recursive, or streaming exact (default G)\n"
+              << "  --stream-rows N        decode and reduce N rows at a time (TIFF strips, PNG rows, JPEG\n"
+              << "                         scanlines) so memory does not grow with image size; 0 = off (default)\n"
+              << "  --preview 2|4|8        quick run at 1/2, 1/4 or 1/8 resolution with the blur radius scaled to\n"
+              << "                         match; writes preview/*_preview.csv and reports the error against existing\n"
+              << "                         full-resolution CSVs (default 1 = off)\n"
+              << "  --mmap on|off          reduce uncompressed RGB TIFFs and .dgraw files straight from a\n"
+              << "                         memory mapping instead of decoding a copy (default on)\n"
+              << "  --csv-precision N      significant digits of CSV values, 0 for the shortest text that reads\n"
+              << "                         back exactly (default 6)\n"
+              << "  --binary-profiles F    also write each CSV's table as NumPy .npy, MATLAB .mat, both, or\n"
+              << "                         none (default)\n"
+              << "  --incremental on|off   only rebuild RPM groups whose images or parameters changed since the\n"
+              << "                         CSVs recorded in <output>/<ID>_manifest.txt were written (default on)\n"
+              << "  --column-cache on|off  keep all-channel column profiles in <output>/column_cache and reuse\n"
+              << "                         them while the images are unchanged; reduces all three channels even\n"
+              << "                         with a single --channel, up to 3x the reduction work (default off)\n"
+              << "  --aligned-images FMT   save aligned images for verification as none (default), float, 16 or 8 bit\n"
+              << "  --aligned-compression C\n"
+              << "                         none (default), lzw or deflate TIFF compression\n"
+              << "  --aligned-width N      downscale aligned images to N pixels wide, 0 for full size (default)\n"
+              << "  --job-file FILE        JSON/YAML file with a \"jobs\" list (and optional \"defaults\");\n"
+              << "                         the options above act as defaults for every job\n"
+              << "  --jobs N               datasets processed concurrently (default 1)\n"
+              << "  --decode-threads N     threads decoding images, shared by all datasets\n"
+              << "  --queue-depth N        RPM groups buffered between pipeline stages (default 2)\n"
+              << "  --log-level LEVEL      quiet (errors only), info (default) or debug (per-image diagnostics)\n"
+              << "  --watch on|off         keep watching the input folders and process each RPM group as soon as\n"
+              << "                         its replicates have been written, until Ctrl+C (default off)\n"
+              << "  --trace FILE           write a Chrome trace JSON timeline of all stages (chrome://tracing, Perfetto)\n"
+              << "  --help                 show this message" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    // Parse command-line controls
+    int decodeThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    int queueDepth = 2;
+    int parallelJobs = 1;
+    std::string jobFile;
+    std::string traceFile;
+    bool watch = false;
+    JobConfig commandLineJob;
+    bool haveDatasetArguments = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        std::string value = hasValue ? argv[i + 1] : "";
+        int integer = 0;
+        bool validValue = hasValue;
+
+        if (arg == "--help" || arg == "-h") {
+            printUsage();
+            return 0;
+        } else if (arg == "--decode-threads") {
+            validValue = validValue && parseInteger(value, integer);
+            decodeThreads = std::max(1, integer);
+        } else if (arg == "--queue-depth") {
+            validValue = validValue && parseInteger(value, integer);
+            queueDepth = std::max(1, integer);
+        } else if (arg == "--jobs") {
+            validValue = validValue && parseInteger(value, integer);
+            parallelJobs = std::max(1, integer);
+        } else if (arg == "--log-level") {
+            validValue = validValue && parseLogLevel(value);
+        } else if (arg == "--trace") {
+            traceFile = value;
+        } else if (arg == "--job-file") {
+            jobFile = value;
+        } else if (arg == "--identifier") {
+            commandLineJob.identifier = value;
+        } else if (arg == "--input") {
+            commandLineJob.inputFolder = value;
+        } else if (arg == "--output") {
+            commandLineJob.outputFolder = value;
+        } else if (arg == "--upper") {
+            validValue = validValue && parseNumber(value, commandLineJob.options.distanceUpper);
+        } else if (arg == "--lower") {
+            validValue = validValue && parseNumber(value, commandLineJob.options.distanceLower);
+        } else if (arg == "--channel") {
+            validValue = validValue && value.size() == 1;
+            commandLineJob.options.channelChoice = static_cast<char>(std::toupper(value.empty() ? ' ' : value[0]));
+        } else if (arg == "--blur-radius") {
+            validValue = validValue && parseInteger(value, commandLineJob.options.blurRadius);
+        } else if (arg == "--blur-method") {
+            validValue = validValue && parseBlurMethod(value, commandLineJob.options.blurMethod);
+        } else if (arg == "--aligned-images") {
+            validValue = validValue && parseAlignedImageFormat(value, commandLineJob.options.alignedImageFormat);
+        } else if (arg == "--aligned-compression") {
+            validValue = validValue && parseTiffCompression(value, commandLineJob.options.alignedImageCompression);
+        } else if (arg == "--stream-rows") {
+            validValue = validValue && parseInteger(value, commandLineJob.options.streamRows);
+        } else if (arg == "--preview") {
+            validValue = validValue && parseInteger(value, commandLineJob.options.previewScale);
+        } else if (arg == "--csv-precision") {
+            validValue = validValue && parseInteger(value, commandLineJob.options.csvPrecision);
+        } else if (arg == "--binary-profiles") {
+            validValue = validValue && parseProfileBinaryFormat(value, commandLineJob.options.binaryProfiles);
+        } else if (arg == "--watch") {
+            validValue = validValue && (value == "on" || value == "off");
+            watch = value == "on";
+        } else if (arg == "--incremental") {
+            validValue = validValue && (value == "on" || value == "off");
+            commandLineJob.options.incremental = value == "on";
+        } else if (arg == "--column-cache") {
+            validValue = validValue && (value == "on" || value == "off");
+            commandLineJob.options.columnCache = value == "on";
+        } else if (arg == "--mmap") {
+            validValue = validValue && (value == "on" || value == "off");
+            commandLineJob.options.memoryMap = value == "on";
+        } else if (arg == "--aligned-width") {
+            validValue = validValue && parseInteger(value, commandLineJob.options.alignedImageWidth);
+        } else {
+            std::cerr << "Error: Unknown argument: " << arg << std::endl;
+            printUsage();
+            return -1;
+        }
+
+        if (!validValue) {
+            std::cerr << "Error: Missing or invalid value for " << arg << std::endl;
+            return -1;
+        }
+        haveDatasetArguments = haveDatasetArguments ||
+                               (arg != "--decode-threads" && arg != "--queue-depth" && arg != "--jobs" && arg != "--log-level" &&
+                                arg != "--trace" && arg != "--watch");
+        ++i;
+    }
+
+    std::vector<JobConfig> jobs;
+    if (!haveDatasetArguments) {
+        // Ask user for the identifier
+        JobConfig job;
+        std::cout << "Enter the identifier for the dataset (e.g., W, SF, etc.): ";
+        std::cin >> job.identifier;
+
+        // Initialize logging after getting the identifier
+        initializeLogging(job.identifier);
+        promptForJob(job);
+        jobs.push_back(job);
+    } else {
+        if (!jobFile.empty()) {
+            if (!loadJobFile(jobFile, commandLineJob, jobs)) {
+                return -1;
+            }
+        } else {
+            jobs.push_back(commandLineJob);
+        }
+        if (jobs.empty()) {
+            std::cerr << "Error: No datasets to process." << std::endl;
+            return -1;
+        }
+        for (const auto& job : jobs) {
+            if (!validateJob(job)) {
+                return -1;
+            }
+        }
+        initializeLogging(jobs.size() == 1 ? jobs.front().identifier : fs::path(jobFile).stem().string());
+    }
+    // Run the datasets, up to parallelJobs at a time, all decoding on one shared pool
+    ThreadPool decodePool(decodeThreads);
+    if (logEnabled(LogLevel::Info)) {
+        std::cout << "Column reduction kernel: " << simdLevelName(detectSimdLevel()) << std::endl;
+        std::cout << "Decoding with " << decodePool.size() << " threads, pipeline queue depth " << queueDepth
+                  << ", " << jobs.size() << " dataset(s), " << parallelJobs << " at a time" << std::endl;
+    }
+
+    if (!traceFile.empty()) {
+        g_trace.start();
+    }
+    auto runStart = std::chrono::steady_clock::now();
+    std::atomic<size_t> nextJob{0};
+    std::atomic<int> failedJobs{0};
+    std::vector<std::thread> jobRunners;
+    if (watch) {
+        // Every dataset is watched at once, each on its own thread, until Ctrl+C
+        std::signal(SIGINT, stopWatching);
+        for (const auto& job : jobs) {
+            jobRunners.emplace_back([&] {
+                if (!watchJob(job, decodePool, queueDepth)) {
+                    ++failedJobs;
+                }
+            });
+        }
+    }
+    for (int i = 0; i < std::min<int>(watch ? 0 : parallelJobs, static_cast<int>(jobs.size())); ++i) {
+        jobRunners.emplace_back([&] {
+            for (size_t job = nextJob++; job < jobs.size(); job = nextJob++) {
+                if (!runJob(jobs[job], decodePool, queueDepth)) {
+                    ++failedJobs;
+                }
+            }
+        });
+    }
+    for (auto& runner : jobRunners) {
+        runner.join();
+    }
+
+    if (logEnabled(LogLevel::Info)) {
+        std::chrono::duration<double> wallTime = std::chrono::steady_clock::now() - runStart;
+        printPerformanceReport(wallTime.count());
+    }
+    if (!traceFile.empty() && g_trace.write(traceFile) && logEnabled(LogLevel::Info)) {
+        std::cout << "Wrote trace to: " << traceFile << std::endl;
+    }
+
+    return failedJobs > 0 ? -1 : 0;
 }
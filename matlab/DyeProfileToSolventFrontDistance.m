@@ -34,7 +34,8 @@ for dataset_idx = 1:num_datasets
         error('No folder selected. Please run the script again and select a folder.');
     end
 
-    % Get a list of all CSV files in the selected folder
+    % Get a list of all CSV files in the selected folder (previews made with --preview are in its
+    % 'preview' subfolder, so they are not mixed with the full-resolution profiles)
     csv_files = dir(fullfile(folder_path, '*.csv'));
 
     % Create a cell array to store file information
@@ -71,8 +72,15 @@ for dataset_idx = 1:num_datasets
         rpm = file_info{file_idx,2};
         rpm_str = num2str(rpm);
         
-        % Read data from the current CSV file
-        data = readmatrix(fullfile(folder_path, file_name));
+        % Read data from the current CSV file, or from the .mat copy written next to it
+        % (--binary-profiles mat), which loads without parsing text
+        mat_file = fullfile(folder_path, strrep(file_name, '.csv', '.mat'));
+        if isfile(mat_file)
+            mat_data = load(mat_file);
+            data = [mat_data.distance, mat_data.profiles, mat_data.average];
+        else
+            data = readmatrix(fullfile(folder_path, file_name));
+        end
         
         % Extract distance and intensity values for each replicate
         distance = data(:, 1);